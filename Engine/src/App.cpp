@@ -2,6 +2,7 @@
 
 #include <chrono>
 
+#include "Archive.h"
 #include "Renderer.h"
 
 namespace Ash {
@@ -19,6 +20,9 @@ void App::init() {
     Log::init();
     Window::init();
 
+    // Packed by ashcook, assets are read from assets/ without it
+    Archive::mount("assets.ashpak");
+
     // Initialize window
     instance->window = Window::create({
         "Ash",
@@ -45,6 +49,7 @@ void App::cleanup() {
     Renderer::cleanup();
     instance->window->destroy();
     Window::cleanup();
+    Archive::unmount();
 
     for (auto system : instance->systems) delete system;
 
@@ -0,0 +1,94 @@
+#include "Archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Log.h"
+
+namespace Ash {
+
+MappedFile Archive::file;
+std::unordered_map<std::string, Archive::Entry> Archive::entries;
+
+bool Archive::mount(const std::string& path) {
+    unmount();
+
+    if (!file.open(path)) {
+        ASH_INFO("No archive at {}, reading loose assets", path);
+        return false;
+    }
+
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+
+    Header header;
+    if (size < sizeof(Header)) {
+        ASH_WARN("{} is not an asset archive", path);
+        unmount();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(Header));
+
+    if (header.magic != MAGIC || header.version != VERSION) {
+        ASH_WARN("{} is not an asset archive of version {}", path, VERSION);
+        unmount();
+        return false;
+    }
+
+    size_t tocSize = size_t(header.entryCount) * sizeof(TocEntry);
+    size_t stringOffset = sizeof(Header) + tocSize;
+    if (stringOffset + header.stringSize > size || header.stringSize == 0 ||
+        data[stringOffset + header.stringSize - 1] != '\0') {
+        ASH_WARN("{} is truncated", path);
+        unmount();
+        return false;
+    }
+
+    std::vector<TocEntry> toc(header.entryCount);
+    std::memcpy(toc.data(), data + sizeof(Header), tocSize);
+    const char* strings = reinterpret_cast<const char*>(data + stringOffset);
+
+    entries.reserve(toc.size());
+    for (const TocEntry& tocEntry : toc) {
+        if (tocEntry.offset > size || tocEntry.size > size - tocEntry.offset ||
+            tocEntry.path >= header.stringSize) {
+            ASH_WARN("{} is corrupt", path);
+            unmount();
+            return false;
+        }
+
+        entries[strings + tocEntry.path] = {
+            tocEntry.type, data + tocEntry.offset,
+            static_cast<size_t>(tocEntry.size)};
+    }
+
+    // Everything in the archive is about to be loaded, one large read beats
+    // faulting it in page by page
+    file.prefetch();
+
+    ASH_INFO("Mounted {} with {} assets ({} bytes)", path, entries.size(),
+             size);
+    return true;
+}
+
+void Archive::unmount() {
+    entries.clear();
+    file.close();
+}
+
+const Archive::Entry* Archive::find(const std::string& path) {
+    if (entries.empty()) return nullptr;
+
+    auto entry = entries.find(normalize(path));
+    return entry != entries.end() ? &entry->second : nullptr;
+}
+
+std::string Archive::normalize(const std::string& path) {
+    std::string result = path;
+    std::replace(result.begin(), result.end(), '\\', '/');
+    while (result.starts_with("./")) result.erase(0, 2);
+    return result;
+}
+
+}  // namespace Ash
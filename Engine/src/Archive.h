@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "MappedFile.h"
+
+namespace Ash {
+
+// A single file packed by ashcook holding every cooked asset, looked up by
+// the path of the asset it was cooked from. The table of contents is read
+// once when mounting and entries point straight into the mapped file
+class Archive {
+   public:
+    enum class Type : uint32_t {
+        // Stored as-is, like SPIR-V
+        Raw,
+        // A KTX2 file
+        Texture,
+        // A cooked MeshFile
+        Mesh,
+    };
+
+    struct Entry {
+        Type type;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    // On disk, followed by the table of contents and then a string table
+    // holding the paths
+    struct Header {
+        std::array<char, 4> magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t stringSize;
+    };
+
+    struct TocEntry {
+        uint64_t offset;
+        uint64_t size;
+        Type type;
+        // Offset of the null terminated path in the string table
+        uint32_t path;
+    };
+
+    static constexpr std::array<char, 4> MAGIC = {'A', 'S', 'H', 'P'};
+    static const uint32_t VERSION = 1;
+    // Entries start on this alignment, so that their data can be read in
+    // place
+    static const uint32_t ALIGNMENT = 16;
+
+    // Loose files are read when no archive is mounted
+    static bool mount(const std::string& path);
+    static void unmount();
+
+    // Null when the path isn't in the mounted archive
+    static const Entry* find(const std::string& path);
+
+    // Paths use forward slashes without a leading ./
+    static std::string normalize(const std::string& path);
+
+   private:
+    static MappedFile file;
+    static std::unordered_map<std::string, Entry> entries;
+};
+
+}  // namespace Ash
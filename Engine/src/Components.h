@@ -28,24 +28,32 @@ struct Transform {
     }
 };
 
+// Set through Scene::setParent, which keeps Parent and Children in sync
+struct Parent {
+    entt::entity entity{entt::null};
+};
+
+struct Children {
+    std::vector<entt::entity> entities;
+};
+
+// Local to world matrix including all parents, cached by the TransformSystem
+// and only recomputed when the entity or one of its parents moves
+struct WorldTransform {
+    glm::mat4 matrix{1.0f};
+};
+
+// Tags an entity whose transform never changes once it is drawn. Its object
+// data is uploaded once to device local memory instead of every frame, so
+// moving it has no visible effect until the draw list changes
+struct Static {};
+
 struct Renderable {
     Renderable(const std::string& model, const std::string& pipeline)
-        : model(model), pipeline(pipeline) {
-        descriptorSets.resize(Renderer::getModel(model).meshes.size());
-        for (uint32_t i = 0; i < Renderer::getModel(model).meshes.size(); i++) {
-            Renderer::getAPI()->createDescriptorSets(
-                descriptorSets[i],
-                Renderer::getTexture(Renderer::getModel(model).textures[i]));
-        }
-        id = Renderer::getScene()->entityCounter++;
-    }
-
-    std::vector<std::vector<VkDescriptorSet>> descriptorSets;
+        : model(model), pipeline(pipeline) {}
 
     std::string model;
     std::string pipeline;
-
-    uint32_t id;
 };
 
 }  // namespace Ash
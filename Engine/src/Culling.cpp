@@ -0,0 +1,113 @@
+#include "Culling.h"
+
+#include <bit>
+#include <limits>
+
+#include "Simd.h"
+
+namespace Ash {
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    // Gribb-Hartmann, the planes are sums of the matrix rows
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row2;
+    planes[5] = row3 - row2;
+
+    for (glm::vec4& plane : planes) plane /= glm::length(glm::vec3(plane));
+}
+
+void FrustumCuller::resize(size_t count) {
+    this->count = count;
+
+    size_t padded = (count + ASH_SIMD_WIDTH - 1) / ASH_SIMD_WIDTH;
+    padded *= ASH_SIMD_WIDTH;
+
+    centerX.resize(padded, 0.0f);
+    centerY.resize(padded, 0.0f);
+    centerZ.resize(padded, 0.0f);
+    radii.resize(padded);
+
+    // Shrinking may have left stale spheres in the padding
+    std::fill(radii.begin() + count, radii.end(),
+              std::numeric_limits<float>::lowest());
+}
+
+void FrustumCuller::cull(const Frustum& frustum,
+                         std::vector<uint32_t>& visible) const {
+    const size_t padded = radii.size();
+
+#if ASH_SIMD_WIDTH == 8
+    for (size_t i = 0; i < padded; i += 8) {
+        __m256 x = _mm256_loadu_ps(&centerX[i]);
+        __m256 y = _mm256_loadu_ps(&centerY[i]);
+        __m256 z = _mm256_loadu_ps(&centerZ[i]);
+        __m256 negRadius =
+            _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radii[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)),
+                              _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)),
+                              _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(
+                inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+        }
+
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+        while (mask) {
+            visible.push_back(static_cast<uint32_t>(i) +
+                              std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+#elif ASH_SIMD_WIDTH == 4
+    for (size_t i = 0; i < padded; i += 4) {
+        __m128 x = _mm_loadu_ps(&centerX[i]);
+        __m128 y = _mm_loadu_ps(&centerY[i]);
+        __m128 z = _mm_loadu_ps(&centerZ[i]);
+        __m128 negRadius =
+            _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radii[i]));
+
+        __m128 inside = _mm_cmpeq_ps(x, x);
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                                      _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                           _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)),
+                                      _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+        while (mask) {
+            visible.push_back(static_cast<uint32_t>(i) +
+                              std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+#else
+    for (size_t i = 0; i < padded; i++) {
+        glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes)
+            inside &=
+                glm::dot(glm::vec3(plane), center) + plane.w >= -radii[i];
+
+        if (inside) visible.push_back(static_cast<uint32_t>(i));
+    }
+#endif
+}
+
+}  // namespace Ash
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Simd.h"
+
+namespace Ash {
+
+enum class CullingMode {
+    // Draw every instance
+    None,
+    // Test world space spheres on the CPU with SIMD
+    Cpu,
+    // Test instances in a compute pass that writes the indirect draws
+    Gpu
+};
+
+inline namespace ASH_SIMD_NAMESPACE {
+
+struct Frustum {
+    // Extracts the planes of a view projection matrix with zero to one depth.
+    // Normals point inwards and are normalized
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    std::array<glm::vec4, 6> planes;
+};
+
+// Keeps world space bounding spheres in a structure of arrays layout so that
+// a full SIMD register of them can be tested against a plane at once
+class FrustumCuller {
+   public:
+    void resize(size_t count);
+
+    void set(size_t index, const glm::vec3& center, float radius) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        radii[index] = radius;
+    }
+
+    // Appends the indices of every sphere that intersects the frustum to
+    // visible, in ascending order
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    size_t size() const { return count; }
+
+   private:
+    // Arrays are padded to a full register with spheres that are never
+    // visible
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radii;
+
+    size_t count = 0;
+};
+
+}  // namespace ASH_SIMD_NAMESPACE
+}  // namespace Ash
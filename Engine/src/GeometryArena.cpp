@@ -0,0 +1,166 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+#include "Core.h"
+#include "Log.h"
+
+namespace Ash {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+void GeometryArena::init(VkDeviceSize capacity) {
+    this->capacity = capacity;
+
+    blocks.clear();
+    freeHandles.clear();
+    live.clear();
+    freeRanges.clear();
+    freeRanges[0] = capacity;
+
+    used = 0;
+    allocationCount = 0;
+}
+
+GeometryArena::Handle GeometryArena::allocate(VkDeviceSize size,
+                                              VkDeviceSize alignment) {
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+
+    VkDeviceSize offset = 0;
+    if (size > 0) {
+        // First fit, which keeps allocations towards the front and the free
+        // space in one piece at the back
+        auto range = freeRanges.begin();
+        for (; range != freeRanges.end(); ++range) {
+            offset = alignUp(range->first, alignment);
+            if (offset + size <= range->first + range->second) break;
+        }
+        if (range == freeRanges.end()) return INVALID;
+
+        VkDeviceSize start = range->first;
+        VkDeviceSize end = range->first + range->second;
+        freeRanges.erase(range);
+        if (offset > start) freeRanges[start] = offset - start;
+        if (offset + size < end)
+            freeRanges[offset + size] = end - offset - size;
+    }
+
+    Handle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = static_cast<Handle>(blocks.size());
+        blocks.emplace_back();
+        live.push_back(false);
+    }
+
+    blocks[handle] = {offset, size, alignment};
+    live[handle] = true;
+
+    used += size;
+    allocationCount++;
+    return handle;
+}
+
+void GeometryArena::free(Handle handle) {
+    ASH_ASSERT(handle < blocks.size() && live[handle],
+               "Freeing geometry range {} twice", handle);
+
+    const Block& block = blocks[handle];
+    release(block.offset, block.size);
+
+    live[handle] = false;
+    freeHandles.push_back(handle);
+
+    used -= block.size;
+    allocationCount--;
+}
+
+void GeometryArena::release(VkDeviceSize offset, VkDeviceSize size) {
+    if (size == 0) return;
+
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+
+    freeRanges[offset] = size;
+}
+
+std::vector<VkBufferCopy> GeometryArena::compact(VkDeviceSize capacity) {
+    std::vector<Handle> order = liveBlocks();
+
+    std::vector<VkBufferCopy> copies;
+    freeRanges.clear();
+    VkDeviceSize head = 0;
+    for (Handle handle : order) {
+        Block& block = blocks[handle];
+        VkDeviceSize offset = alignUp(head, block.alignment);
+        if (offset > head) freeRanges[head] = offset - head;
+
+        // Ranges that were already next to each other stay one copy
+        VkBufferCopy* last = copies.empty() ? nullptr : &copies.back();
+        if (last && last->srcOffset + last->size == block.offset &&
+            last->dstOffset + last->size == offset)
+            last->size += block.size;
+        else
+            copies.push_back({block.offset, offset, block.size});
+
+        block.offset = offset;
+        head = offset + block.size;
+    }
+
+    ASH_ASSERT(head <= capacity, "Compacting {} bytes into {}", head,
+               capacity);
+
+    this->capacity = capacity;
+    if (head < capacity) freeRanges[head] = capacity - head;
+
+    return copies;
+}
+
+VkDeviceSize GeometryArena::getCompactedSize() const {
+    VkDeviceSize head = 0;
+    for (Handle handle : liveBlocks()) {
+        const Block& block = blocks[handle];
+        head = alignUp(head, block.alignment) + block.size;
+    }
+    return head;
+}
+
+VkDeviceSize GeometryArena::getLargestFree() const {
+    VkDeviceSize largest = 0;
+    for (const auto& [offset, size] : freeRanges)
+        largest = std::max(largest, size);
+    return largest;
+}
+
+std::vector<GeometryArena::Handle> GeometryArena::liveBlocks() const {
+    std::vector<Handle> order;
+    order.reserve(allocationCount);
+    for (Handle handle = 0; handle < blocks.size(); handle++)
+        if (live[handle] && blocks[handle].size > 0) order.push_back(handle);
+
+    std::sort(order.begin(), order.end(), [&](Handle a, Handle b) {
+        return blocks[a].offset < blocks[b].offset;
+    });
+    return order;
+}
+
+}  // namespace Ash
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace Ash {
+
+// Hands out ranges of one large buffer from a free list, merging freed ranges
+// with their neighbours. Once no free range fits, the live ranges can be
+// packed to the front of a new buffer, which is why allocations are referred
+// to by handle rather than by offset
+class GeometryArena {
+   public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID = ~0u;
+
+    void init(VkDeviceSize capacity);
+
+    // Offsets are multiples of the alignment, which doesn't have to be a
+    // power of two. Returns INVALID if no free range fits
+    Handle allocate(VkDeviceSize size, VkDeviceSize alignment);
+    void free(Handle handle);
+
+    VkDeviceSize getOffset(Handle handle) const {
+        return blocks[handle].offset;
+    }
+
+    // Packs every allocation to the front of a buffer of the given capacity,
+    // keeping their order. Returns the copies that move the data from the old
+    // buffer into the new one
+    std::vector<VkBufferCopy> compact(VkDeviceSize capacity);
+
+    VkDeviceSize getCapacity() const { return capacity; }
+    // Bytes in live allocations, alignment padding excluded
+    VkDeviceSize getUsed() const { return used; }
+    // End of the last allocation once compacted
+    VkDeviceSize getCompactedSize() const;
+    VkDeviceSize getLargestFree() const;
+    uint32_t getAllocationCount() const { return allocationCount; }
+
+   private:
+    struct Block {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        VkDeviceSize alignment;
+    };
+
+    void release(VkDeviceSize offset, VkDeviceSize size);
+    // Live allocations in offset order
+    std::vector<Handle> liveBlocks() const;
+
+    std::vector<Block> blocks;
+    std::vector<Handle> freeHandles;
+    std::vector<bool> live;
+
+    // Size of every free range, keyed by offset so neighbours are adjacent
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+
+    VkDeviceSize capacity = 0;
+    VkDeviceSize used = 0;
+    uint32_t allocationCount = 0;
+};
+
+}  // namespace Ash
@@ -4,14 +4,47 @@
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <fstream>
 
+#include "Archive.h"
 #include "Core.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
 #include "Renderer.h"
 
 namespace Ash::Helper {
 
+namespace {
+
+// Folds the lower hemisphere over the upper one, so a unit vector fits in two
+// components with even precision in every direction
+glm::vec2 encodeOctahedral(glm::vec3 n) {
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0.0f) return glm::vec2(0.0f);
+
+    n /= sum;
+    glm::vec2 encoded(n.x, n.y);
+    if (n.z < 0.0f) {
+        encoded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+                  glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f,
+                            n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+}  // namespace
+
 std::vector<char> readBinaryFile(const char* filename) {
+    if (const Archive::Entry* entry = Archive::find(filename))
+        return std::vector<char>(entry->data, entry->data + entry->size);
+
     std::ifstream istream(filename, std::ios::ate | std::ios::binary);
 
     ASH_ASSERT(istream.is_open(), "Failed to open file {}", filename);
@@ -25,10 +58,113 @@ std::vector<char> readBinaryFile(const char* filename) {
     return buffer;
 }
 
-void processMesh(aiMesh* mesh, const std::string& name, uint32_t iteration) {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+Bounds computeBounds(const std::vector<Vertex>& vertices) {
+    Bounds bounds{};
+    if (vertices.empty()) return bounds;
+
+    bounds.min = bounds.max = vertices[0].pos;
+    for (const Vertex& vertex : vertices) {
+        bounds.min = glm::min(bounds.min, vertex.pos);
+        bounds.max = glm::max(bounds.max, vertex.pos);
+    }
+
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+
+    // Tighter than half the box diagonal for most meshes
+    float radius2 = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        glm::vec3 offset = vertex.pos - bounds.center;
+        radius2 = glm::max(radius2, glm::dot(offset, offset));
+    }
+    bounds.radius = glm::sqrt(radius2);
+
+    return bounds;
+}
+
+void compressVertices(const Vertex* vertices, size_t count,
+                      const Bounds& bounds, CompressedVertex* compressed) {
+    // Flat meshes have no extent along one axis, which decodes to the minimum
+    glm::vec3 extent = bounds.max - bounds.min;
+    glm::vec3 inverse(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                      extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                      extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = vertices[i];
+        CompressedVertex& out = compressed[i];
+
+        glm::vec3 position = (vertex.pos - bounds.min) * inverse;
+        for (int c = 0; c < 3; c++)
+            out.pos[c] = glm::packUnorm1x16(position[c]);
+        out.pos[3] = vertex.tangent.w < 0.0f ? 0 : 0xFFFF;
+
+        out.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+        out.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+
+        glm::vec2 normal = encodeOctahedral(vertex.normal);
+        glm::vec2 tangent = encodeOctahedral(glm::vec3(vertex.tangent));
+        for (int c = 0; c < 2; c++) {
+            out.normal[c] = static_cast<int16_t>(glm::packSnorm1x16(normal[c]));
+            out.tangent[c] =
+                static_cast<int16_t>(glm::packSnorm1x16(tangent[c]));
+        }
+    }
+}
+
+std::vector<uint8_t> downsampleImage(const uint8_t* pixels, uint32_t width,
+                                     uint32_t height, bool srgb) {
+    static const std::array<float, 256> toLinear = [] {
+        std::array<float, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f
+                                     : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+
+    auto toSrgb = [](float c) {
+        c = c <= 0.0031308f ? c * 12.92f
+                            : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+    };
+
+    uint32_t halfWidth = std::max(width / 2, 1u);
+    uint32_t halfHeight = std::max(height / 2, 1u);
+    uint32_t srgbChannels = srgb ? 3 : 0;
+    std::vector<uint8_t> result(size_t(halfWidth) * halfHeight * 4);
+
+    for (uint32_t y = 0; y < halfHeight; y++) {
+        const uint8_t* row0 = pixels + size_t(std::min(y * 2, height - 1)) *
+                                           width * 4;
+        const uint8_t* row1 = pixels + size_t(std::min(y * 2 + 1, height - 1)) *
+                                           width * 4;
+
+        for (uint32_t x = 0; x < halfWidth; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+            uint8_t* out = &result[(size_t(y) * halfWidth + x) * 4];
 
+            for (uint32_t c = 0; c < srgbChannels; c++) {
+                float sum = toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] +
+                            toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]];
+                out[c] = toSrgb(sum * 0.25f);
+            }
+
+            // Alpha is always stored linearly
+            for (uint32_t c = srgbChannels; c < 4; c++) {
+                uint32_t sum =
+                    row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                out[c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+
+    return result;
+}
+
+void processMesh(aiMesh* mesh, std::vector<Vertex>& vertices,
+                 std::vector<uint32_t>& indices) {
     vertices.reserve(mesh->mNumVertices);
 
     for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
@@ -40,6 +176,22 @@ void processMesh(aiMesh* mesh, const std::string& name, uint32_t iteration) {
             vertex.texCoord.x = mesh->mTextureCoords[0][i].x;
             vertex.texCoord.y = mesh->mTextureCoords[0][i].y;
         }
+        if (mesh->mNormals) {
+            const aiVector3D& normal = mesh->mNormals[i];
+            vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+        }
+        if (mesh->mTangents && mesh->mBitangents) {
+            const aiVector3D& tangent = mesh->mTangents[i];
+            const aiVector3D& bitangent = mesh->mBitangents[i];
+            glm::vec3 t(tangent.x, tangent.y, tangent.z);
+            glm::vec3 b(bitangent.x, bitangent.y, bitangent.z);
+
+            // Shaders rebuild the bitangent from the normal and tangent
+            float handedness =
+                glm::dot(glm::cross(vertex.normal, t), b) < 0.0f ? -1.0f
+                                                                  : 1.0f;
+            vertex.tangent = glm::vec4(t, handedness);
+        }
         vertices.push_back(vertex);
     }
 
@@ -56,63 +208,74 @@ void processMesh(aiMesh* mesh, const std::string& name, uint32_t iteration) {
             indices.push_back(face.mIndices[j]);
         }
     }
-
-    Renderer::loadMesh(name + "_" + std::to_string(iteration), vertices,
-                       indices);
 }
 
-std::vector<std::string> loadTextures(const std::string& name,
-                                      const std::string& directory,
-                                      aiMaterial* mat, aiTextureType type,
-                                      const std::string& typeName) {
-    std::vector<std::string> textures;
-    textures.reserve(mat->GetTextureCount(type));
-    for (uint32_t i = 0; i < mat->GetTextureCount(type); i++) {
-        aiString path;
-        mat->GetTexture(type, i, &path);
-        Renderer::loadTexture(name + typeName + std::to_string(i),
-                              directory + std::string(path.C_Str()));
-        textures.emplace_back(name + typeName + std::to_string(i));
-    }
+void processNode(const aiScene* scene, const std::string& file,
+                 MeshFile::Model& model) {
+    MeshOptimizer::CacheStats before, after;
+    for (uint32_t i = 0; i < scene->mNumMeshes; i++) {
+        aiMesh* mesh = scene->mMeshes[i];
 
-    return textures;
-}
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        processMesh(mesh, vertices, indices);
 
-void processNode(const aiScene* scene, const std::string& name,
-                 const std::string& directory, uint32_t iteration) {
-    std::vector<std::string> meshes;
-    std::vector<std::string> textures;
+        before += MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+        MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+        MeshOptimizer::optimizeOverdraw(indices, vertices);
+        MeshOptimizer::optimizeVertexFetch(vertices, indices);
+        after += MeshOptimizer::analyzeVertexCache(indices, vertices.size());
 
-    for (uint32_t i = 0; i < scene->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[i];
-        processMesh(mesh, name, iteration++);
+        // Each mesh is drawn with its material's first diffuse texture, named
+        // after the material so that meshes sharing one load it once
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-            std::vector<std::string> texs = loadTextures(
-                name, directory, material, aiTextureType_DIFFUSE, "diffuse");
-            textures.insert(textures.end(), texs.begin(), texs.end());
+            aiString path;
+            material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+            model.addSubmesh(vertices, indices,
+                             "diffuse" + std::to_string(mesh->mMaterialIndex),
+                             path.C_Str());
         } else {
             ASH_INFO("Using backup texture");
-            textures.push_back("white");
+            model.addSubmesh(vertices, indices, "", "");
         }
     }
 
-    meshes.reserve(iteration);
+    ASH_INFO("Optimised {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+             file, before.acmr(), after.acmr(), before.atvr(), after.atvr());
+}
 
-    for (uint32_t i = 0; i < iteration; i++) {
-        meshes.emplace_back(name + "_" + std::to_string(i));
-    }
+// Cooked files are used until the source is modified. They can also be
+// shipped without their source
+bool isCookedCurrent(const std::string& file, const std::string& cooked) {
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(cooked, error);
+    if (error) return false;
 
-    Renderer::loadModel(name, meshes, textures);
+    auto sourceTime = std::filesystem::last_write_time(file, error);
+    return error || cookedTime >= sourceTime;
 }
 
-bool importModel(const std::string& name, const std::string& file) {
+bool cookModel(const std::string& file, MeshFile::Model& model) {
     Assimp::Importer importer;
 
     const aiScene* scene =
         importer.ReadFile(file, aiProcess_Triangulate | aiProcess_FlipUVs |
+                                    aiProcess_GenSmoothNormals |
+                                    aiProcess_CalcTangentSpace |
+                                    aiProcess_JoinIdenticalVertices |
                                     aiProcess_OptimizeMeshes);
+    if (!scene) {
+        ASH_WARN("Failed to import mesh {}: {}", file,
+                 importer.GetErrorString());
+        return false;
+    }
+
+    Helper::processNode(scene, file, model);
+    return true;
+}
 
+bool importModel(const std::string& name, const std::string& file) {
 #ifdef ASH_WINDOWS
     char separator = '\\';
 #else
@@ -121,11 +284,28 @@ bool importModel(const std::string& name, const std::string& file) {
 
     std::string directory = file.substr(0, file.find_last_of(separator) + 1);
 
-    ASH_ASSERT(scene, "Failed to import mesh {}", file);
+    if (const Archive::Entry* entry = Archive::find(file))
+        return MeshFile::load(name, directory, entry->data, entry->size);
+
+    std::string cooked = MeshFile::cookedPath(file);
+    if (isCookedCurrent(file, cooked) && MeshFile::load(name, cooked))
+        return true;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Already logged, nothing is cooked so the next run tries again
+    MeshFile::Model model;
+    if (!cookModel(file, model)) return false;
+
+    // Loaded through the same path as cooked files
+    std::vector<uint8_t> data = MeshFile::serialize(model);
+    MeshFile::load(name, directory, data.data(), data.size());
+
+    auto end = std::chrono::high_resolution_clock::now();
+    ASH_INFO("Imported {} in {:.2f} ms", file,
+             std::chrono::duration<double, std::milli>(end - start).count());
 
-    std::vector<std::string> meshes;
-    std::vector<std::string> textures;
-    Helper::processNode(scene, name, directory, 0);
+    if (MeshFile::save(cooked, data)) ASH_INFO("Cooked {} to {}", file, cooked);
 
     return true;
 }
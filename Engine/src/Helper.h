@@ -8,21 +8,27 @@
 #include <array>
 #include <vector>
 
+#include "GeometryArena.h"
+
 namespace Ash {
-struct UniformBuffer {
-    VkBuffer uniformBuffer;
-    VmaAllocation uniformBufferAllocation;
+// Uploaded once per frame, matches CameraBuffer in shader.vert
+struct CameraData {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 viewProj;
 };
 
-struct UniformBufferObject {
+// Uploaded once per drawn instance
+struct ObjectData {
     glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
 };
 
 struct Vertex {
     glm::vec3 pos;
     glm::vec2 texCoord;
+    glm::vec3 normal{0.0f, 0.0f, 1.0f};
+    // w is the handedness of the bitangent
+    glm::vec4 tangent{1.0f, 0.0f, 0.0f, 1.0f};
 
     static VkVertexInputBindingDescription getBindingDescription() {
         VkVertexInputBindingDescription bindingDescription{};
@@ -34,9 +40,9 @@ struct Vertex {
         return bindingDescription;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 2>
+    static std::array<VkVertexInputAttributeDescription, 4>
     getAttributeDescription() {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions;
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
 
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
@@ -48,30 +54,109 @@ struct Vertex {
         attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
         attributeDescriptions[1].offset = offsetof(Vertex, texCoord);
 
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(Vertex, normal);
+
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[3].offset = offsetof(Vertex, tangent);
+
+        return attributeDescriptions;
+    }
+};
+
+// The layout meshes are uploaded in unless vertex compression is turned off,
+// 20 bytes instead of 48. Positions are 16 bit fractions of the mesh's bounds
+// with the tangent's handedness in w, texture coordinates are half floats and
+// the normal and tangent are octahedral encoded. Decoded in shader.vert
+struct CompressedVertex {
+    uint16_t pos[4];
+    uint16_t texCoord[2];
+    int16_t normal[2];
+    int16_t tangent[2];
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(CompressedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 4>
+    getAttributeDescription() {
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(CompressedVertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(CompressedVertex, texCoord);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[2].offset = offsetof(CompressedVertex, normal);
+
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[3].offset = offsetof(CompressedVertex, tangent);
+
         return attributeDescriptions;
     }
 };
 
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // Bounding sphere around the center of the box
+    glm::vec3 center;
+    float radius;
+};
+
+// A mesh's ranges in the shared vertex and index buffers, looked up when the
+// draws are built since compacting the buffers moves them
 struct IndexedVertexBuffer {
     uint32_t numIndices;
-    VkDeviceSize vertSize;
 
-    VkBuffer buffer;
-    VmaAllocation bufferAllocation;
+    GeometryArena::Handle vertices = GeometryArena::INVALID;
+    GeometryArena::Handle indices = GeometryArena::INVALID;
+
+    // Turns compressed positions back into mesh space, the identity when
+    // vertices aren't compressed
+    glm::vec3 positionScale{1.0f};
+    glm::vec3 positionOffset{0.0f};
 };
 
 struct Mesh {
     std::string name;
+    uint32_t id;
 
     IndexedVertexBuffer ivb;
+    Bounds bounds;
 };
 
 struct Texture {
     std::string name;
+    uint32_t id;
 
     VkImage image;
     VmaAllocation imageAllocation;
     VkImageView imageView;
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t mipLevels = 1;
+    VkDescriptorSet descriptorSet;
 };
 
 struct Model {
@@ -81,9 +166,24 @@ struct Model {
     std::vector<std::string> textures;
 };
 
+namespace MeshFile {
+struct Model;
+}
+
 namespace Helper {
 
 std::vector<char> readBinaryFile(const char* filename);
+Bounds computeBounds(const std::vector<Vertex>& vertices);
+// Quantises positions against the bounds, which must contain all of them
+void compressVertices(const Vertex* vertices, size_t count,
+                      const Bounds& bounds, CompressedVertex* compressed);
+
+// Halves an RGBA8 image with a box filter, averaging sRGB colours in linear
+// space. Odd sizes round down like the levels of a mip chain
+std::vector<uint8_t> downsampleImage(const uint8_t* pixels, uint32_t width,
+                                     uint32_t height, bool srgb = true);
+// Imports a model through Assimp into the cooked layout
+bool cookModel(const std::string& file, MeshFile::Model& model);
 bool importModel(const std::string& name, const std::string& file);
 
 }  // namespace Helper
@@ -0,0 +1,299 @@
+#include "Ktx.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+#include "Log.h"
+
+namespace Ash {
+
+namespace Ktx {
+
+namespace {
+
+const std::array<uint8_t, 12> IDENTIFIER = {0xAB, 0x4B, 0x54, 0x58,
+                                            0x20, 0x32, 0x30, 0xBB,
+                                            0x0D, 0x0A, 0x1A, 0x0A};
+
+struct Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Khronos data format descriptor values for the formats that are written
+const uint32_t MODEL_BC1A = 128;
+const uint32_t MODEL_BC3 = 130;
+const uint32_t MODEL_BC5 = 132;
+const uint32_t MODEL_BC7 = 134;
+const uint32_t PRIMARIES_BT709 = 1;
+const uint32_t TRANSFER_LINEAR = 1;
+const uint32_t TRANSFER_SRGB = 2;
+const uint32_t CHANNEL_COLOR = 0;
+const uint32_t CHANNEL_GREEN = 1;
+const uint32_t CHANNEL_ALPHA = 15;
+// Marks the alpha of sRGB formats, which is never sRGB encoded
+const uint32_t QUALIFIER_LINEAR = 0x10;
+
+bool isSrgb(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+std::vector<uint32_t> makeDataFormatDescriptor(VkFormat format) {
+    struct Sample {
+        uint32_t bitOffset;
+        uint32_t bitLength;
+        uint32_t channel;
+    };
+
+    uint32_t model;
+    std::vector<Sample> samples;
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            model = MODEL_BC1A;
+            samples = {{0, 64, CHANNEL_COLOR}};
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            model = MODEL_BC3;
+            samples = {{0, 64, CHANNEL_ALPHA}, {64, 64, CHANNEL_COLOR}};
+            if (isSrgb(format)) samples[0].channel |= QUALIFIER_LINEAR;
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = MODEL_BC5;
+            samples = {{0, 64, CHANNEL_COLOR}, {64, 64, CHANNEL_GREEN}};
+            break;
+        default:
+            model = MODEL_BC7;
+            samples = {{0, 128, CHANNEL_COLOR}};
+            break;
+    }
+
+    uint32_t blockBytes = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+    std::vector<uint32_t> dfd;
+    dfd.push_back(4 + blockBytes);
+    // Khronos vendor, basic descriptor type
+    dfd.push_back(0);
+    // Version 1.3 of the data format specification
+    dfd.push_back(2 | blockBytes << 16);
+    dfd.push_back(model | PRIMARIES_BT709 << 8 |
+                  (isSrgb(format) ? TRANSFER_SRGB : TRANSFER_LINEAR) << 16);
+    // 4x4 texel blocks, stored as dimension - 1
+    dfd.push_back(3 | 3 << 8);
+    dfd.push_back(blockSize(format));
+    dfd.push_back(0);
+
+    for (const Sample& sample : samples) {
+        dfd.push_back(sample.bitOffset | (sample.bitLength - 1) << 16 |
+                      sample.channel << 24);
+        dfd.push_back(0);
+        dfd.push_back(0);
+        dfd.push_back(UINT32_MAX);
+    }
+    return dfd;
+}
+
+}  // namespace
+
+bool isKtx2(const std::string& path) {
+    return path.size() >= 5 && path.compare(path.size() - 5, 5, ".ktx2") == 0;
+}
+
+uint32_t blockSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t levelSize(VkFormat format, uint32_t width, uint32_t height) {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+bool load(const std::string& path, Image& image) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        ASH_WARN("Failed to open {}", path);
+        return false;
+    }
+
+    std::vector<uint8_t> contents(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+
+    return load(path, contents.data(), contents.size(), image);
+}
+
+bool load(const std::string& path, const uint8_t* data, size_t size,
+          Image& image) {
+    Header header;
+    if (size < sizeof(Header) ||
+        !std::equal(IDENTIFIER.begin(), IDENTIFIER.end(), data)) {
+        ASH_WARN("{} is not a KTX2 file", path);
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(Header));
+
+    VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    if (blockSize(format) == 0) {
+        ASH_WARN("{} has unsupported format {}", path, header.vkFormat);
+        return false;
+    }
+    if (header.pixelHeight == 0 || header.pixelDepth > 1 ||
+        header.layerCount > 1 || header.faceCount != 1) {
+        ASH_WARN("{} is not a 2D texture", path);
+        return false;
+    }
+    if (header.supercompressionScheme != 0) {
+        ASH_WARN("{} uses unsupported supercompression scheme {}", path,
+                 header.supercompressionScheme);
+        return false;
+    }
+
+    // 0 asks for the mips to be generated, which can't be done by blitting
+    // compressed images, so only the base level is used
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    size_t indexOffset = sizeof(Header);
+    if (size < indexOffset + levelCount * sizeof(LevelIndex)) {
+        ASH_WARN("{} is truncated", path);
+        return false;
+    }
+
+    image.format = format;
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.levels.clear();
+    image.data.clear();
+
+    for (uint32_t i = 0; i < levelCount; i++) {
+        LevelIndex index;
+        std::memcpy(&index, data + indexOffset + i * sizeof(LevelIndex),
+                    sizeof(LevelIndex));
+
+        Level level{};
+        level.width = std::max(image.width >> i, 1u);
+        level.height = std::max(image.height >> i, 1u);
+        level.size = levelSize(format, level.width, level.height);
+        level.offset = align(image.data.size(), blockSize(format));
+
+        if (index.byteLength < level.size ||
+            index.byteOffset > size || level.size > size - index.byteOffset) {
+            ASH_WARN("{} is truncated", path);
+            return false;
+        }
+
+        image.data.resize(level.offset + level.size);
+        std::memcpy(image.data.data() + level.offset, data + index.byteOffset,
+                    level.size);
+        image.levels.push_back(level);
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> serialize(const Image& image) {
+    uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+    std::vector<uint32_t> dfd = makeDataFormatDescriptor(image.format);
+
+    Header header{};
+    std::copy(IDENTIFIER.begin(), IDENTIFIER.end(), header.identifier);
+    header.vkFormat = image.format;
+    header.typeSize = 1;
+    header.pixelWidth = image.width;
+    header.pixelHeight = image.height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+
+    size_t indexOffset = sizeof(Header);
+    header.dfdByteOffset =
+        static_cast<uint32_t>(indexOffset + levelCount * sizeof(LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size() * 4);
+
+    // Levels are stored smallest first
+    std::vector<LevelIndex> indices(levelCount);
+    size_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (uint32_t i = levelCount; i-- > 0;) {
+        offset = align(offset, blockSize(image.format));
+        indices[i].byteOffset = offset;
+        indices[i].byteLength = image.levels[i].size;
+        indices[i].uncompressedByteLength = image.levels[i].size;
+        offset += image.levels[i].size;
+    }
+
+    std::vector<uint8_t> contents(offset);
+    std::memcpy(contents.data(), &header, sizeof(Header));
+    std::memcpy(contents.data() + indexOffset, indices.data(),
+                indices.size() * sizeof(LevelIndex));
+    std::memcpy(contents.data() + header.dfdByteOffset, dfd.data(),
+                header.dfdByteLength);
+    for (uint32_t i = 0; i < levelCount; i++)
+        std::memcpy(contents.data() + indices[i].byteOffset,
+                    image.data.data() + image.levels[i].offset,
+                    image.levels[i].size);
+    return contents;
+}
+
+bool save(const std::string& path, const Image& image) {
+    std::vector<uint8_t> contents = serialize(image);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        ASH_WARN("Failed to open {} for writing", path);
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+    return file.good();
+}
+
+}  // namespace Ktx
+
+}  // namespace Ash
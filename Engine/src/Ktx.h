@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Ash {
+
+// Reads and writes KTX2 containers holding block compressed 2D textures.
+// Levels are stored as-is, without supercompression
+namespace Ktx {
+
+struct Level {
+    // Into Image::data, aligned to the format's block size
+    size_t offset;
+    size_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct Image {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // Level 0 is the full size image
+    std::vector<Level> levels;
+    std::vector<uint8_t> data;
+};
+
+bool isKtx2(const std::string& path);
+
+// BC1, BC3, BC5 and BC7 formats, 0 for anything else
+uint32_t blockSize(VkFormat format);
+size_t levelSize(VkFormat format, uint32_t width, uint32_t height);
+
+// Logs why a file couldn't be read and returns false
+bool load(const std::string& path, Image& image);
+bool load(const std::string& path, const uint8_t* data, size_t size,
+          Image& image);
+
+std::vector<uint8_t> serialize(const Image& image);
+bool save(const std::string& path, const Image& image);
+
+}  // namespace Ktx
+
+}  // namespace Ash
@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+
+#ifdef ASH_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Ash {
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef ASH_WINDOWS
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                nullptr, OPEN_EXISTING,
+                                FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    file = handle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+
+    mapped = static_cast<const uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped) {
+        close();
+        return false;
+    }
+
+    length = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::prefetch() {
+    if (!mapped) return;
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(mapped);
+    range.NumberOfBytes = length;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MappedFile::close() {
+    if (mapped) UnmapViewOfFile(mapped);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+
+    mapped = nullptr;
+    mapping = nullptr;
+    file = nullptr;
+    length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+        ::close(descriptor);
+        return false;
+    }
+
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size),
+                         PROT_READ, MAP_PRIVATE, descriptor, 0);
+    // The mapping keeps the file alive on its own
+    ::close(descriptor);
+    if (address == MAP_FAILED) return false;
+
+    // Files are read front to back, once
+    madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    mapped = static_cast<const uint8_t*>(address);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::prefetch() {
+    if (mapped) madvise(const_cast<uint8_t*>(mapped), length, MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+    if (mapped) munmap(const_cast<uint8_t*>(mapped), length);
+
+    mapped = nullptr;
+    length = 0;
+}
+
+#endif
+
+}  // namespace Ash
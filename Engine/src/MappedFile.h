@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Ash {
+
+// A read-only view of a whole file, paged in by the OS as it's read instead
+// of being copied through a stream
+class MappedFile {
+   public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // Asks the OS to read the whole file ahead in one go
+    void prefetch();
+
+    const uint8_t* data() const { return mapped; }
+    size_t size() const { return length; }
+
+   private:
+    const uint8_t* mapped = nullptr;
+    size_t length = 0;
+
+#ifdef ASH_WINDOWS
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+}  // namespace Ash
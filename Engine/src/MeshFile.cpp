@@ -0,0 +1,186 @@
+#include "MeshFile.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "MappedFile.h"
+#include "Renderer.h"
+
+namespace Ash {
+
+namespace MeshFile {
+
+namespace {
+
+size_t align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool inside(uint64_t offset, uint64_t size, size_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+}  // namespace
+
+void Model::addSubmesh(const std::vector<Vertex>& vertices,
+                       const std::vector<uint32_t>& indices,
+                       const std::string& textureName,
+                       const std::string& texturePath) {
+    Submesh submesh{};
+    submesh.vertexOffset = this->vertices.size();
+    submesh.indexOffset = this->indices.size();
+    submesh.vertexCount = static_cast<uint32_t>(vertices.size());
+    submesh.indexCount = static_cast<uint32_t>(indices.size());
+    submesh.bounds = Helper::computeBounds(vertices);
+
+    if (!textureName.empty()) {
+        submesh.textureName = static_cast<uint32_t>(strings.size());
+        strings.append(textureName).push_back('\0');
+        submesh.texturePath = static_cast<uint32_t>(strings.size());
+        strings.append(texturePath).push_back('\0');
+    }
+
+    auto vertexBytes = reinterpret_cast<const uint8_t*>(vertices.data());
+    this->vertices.insert(this->vertices.end(), vertexBytes,
+                          vertexBytes + vertices.size() * sizeof(Vertex));
+    auto indexBytes = reinterpret_cast<const uint8_t*>(indices.data());
+    this->indices.insert(this->indices.end(), indexBytes,
+                         indexBytes + indices.size() * sizeof(uint32_t));
+
+    submeshes.push_back(submesh);
+}
+
+std::string cookedPath(const std::string& path) {
+    return std::filesystem::path(path).replace_extension(".ashmesh").string();
+}
+
+std::vector<uint8_t> serialize(const Model& model) {
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.submeshCount = static_cast<uint32_t>(model.submeshes.size());
+
+    size_t submeshSize = model.submeshes.size() * sizeof(Submesh);
+    header.vertexOffset = align(sizeof(Header) + submeshSize, 16);
+    header.vertexSize = model.vertices.size();
+    header.indexOffset = align(header.vertexOffset + header.vertexSize, 16);
+    header.indexSize = model.indices.size();
+    header.stringOffset = header.indexOffset + header.indexSize;
+    header.stringSize = model.strings.size();
+
+    std::vector<uint8_t> data(header.stringOffset + header.stringSize);
+    std::memcpy(data.data(), &header, sizeof(Header));
+    std::memcpy(data.data() + sizeof(Header), model.submeshes.data(),
+                submeshSize);
+    std::memcpy(data.data() + header.vertexOffset, model.vertices.data(),
+                header.vertexSize);
+    std::memcpy(data.data() + header.indexOffset, model.indices.data(),
+                header.indexSize);
+    std::memcpy(data.data() + header.stringOffset, model.strings.data(),
+                header.stringSize);
+    return data;
+}
+
+bool save(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        ASH_WARN("Failed to open {} for writing", path);
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return file.good();
+}
+
+bool load(const std::string& name, const std::string& directory,
+          const uint8_t* data, size_t size) {
+    Header header;
+    if (size < sizeof(Header)) return false;
+    std::memcpy(&header, data, sizeof(Header));
+
+    if (header.magic != MAGIC || header.version != VERSION ||
+        header.vertexStride != sizeof(Vertex))
+        return false;
+
+    uint64_t submeshSize = uint64_t(header.submeshCount) * sizeof(Submesh);
+    if (!inside(sizeof(Header), submeshSize, size) ||
+        !inside(header.vertexOffset, header.vertexSize, size) ||
+        !inside(header.indexOffset, header.indexSize, size) ||
+        !inside(header.stringOffset, header.stringSize, size) ||
+        header.stringSize == 0 || data[size - 1] != '\0') {
+        ASH_WARN("Cooked model {} is truncated", name);
+        return false;
+    }
+
+    std::vector<Submesh> submeshes(header.submeshCount);
+    std::memcpy(submeshes.data(), data + sizeof(Header), submeshSize);
+
+    const uint8_t* vertices = data + header.vertexOffset;
+    const uint8_t* indices = data + header.indexOffset;
+    const char* strings =
+        reinterpret_cast<const char*>(data + header.stringOffset);
+
+    for (const Submesh& submesh : submeshes) {
+        uint64_t vertexSize = uint64_t(submesh.vertexCount) * sizeof(Vertex);
+        uint64_t indexSize = uint64_t(submesh.indexCount) * sizeof(uint32_t);
+        if (!inside(submesh.vertexOffset, vertexSize, header.vertexSize) ||
+            !inside(submesh.indexOffset, indexSize, header.indexSize) ||
+            submesh.textureName >= header.stringSize ||
+            submesh.texturePath >= header.stringSize) {
+            ASH_WARN("Cooked model {} is corrupt", name);
+            return false;
+        }
+    }
+
+    std::vector<std::string> meshes;
+    std::vector<std::string> textures;
+    for (uint32_t i = 0; i < submeshes.size(); i++) {
+        const Submesh& submesh = submeshes[i];
+
+        meshes.push_back(name + "_" + std::to_string(i));
+        Renderer::loadMesh(
+            meshes.back(), vertices + submesh.vertexOffset,
+            submesh.vertexCount * sizeof(Vertex),
+            reinterpret_cast<const uint32_t*>(indices + submesh.indexOffset),
+            submesh.indexCount, submesh.bounds);
+
+        if (strings[submesh.textureName] == '\0') {
+            textures.push_back("white");
+            continue;
+        }
+
+        // Cooked files don't depend on the name they're loaded as
+        std::string textureName = name + (strings + submesh.textureName);
+
+        // Submeshes sharing a material share its texture
+        if (!Renderer::hasTexture(textureName))
+            Renderer::loadTextureAsync(
+                textureName, directory + (strings + submesh.texturePath));
+        textures.push_back(textureName);
+    }
+
+    Renderer::loadModel(name, meshes, textures);
+    return true;
+}
+
+bool load(const std::string& name, const std::string& path) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    MappedFile file;
+    if (!file.open(path)) return false;
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    if (!load(name, directory, file.data(), file.size())) return false;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    ASH_INFO("Loaded cooked model {} ({} bytes) in {:.2f} ms", path,
+             file.size(),
+             std::chrono::duration<double, std::milli>(end - start).count());
+    return true;
+}
+
+}  // namespace MeshFile
+
+}  // namespace Ash
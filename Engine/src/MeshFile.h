@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Helper.h"
+
+namespace Ash {
+
+// The engine's cooked model format. Vertices and indices are stored exactly
+// as they are uploaded, so loading one is a copy from the file into staging
+// memory with no parsing. Vertices are kept at full precision and only
+// quantised on upload when vertex compression is enabled
+namespace MeshFile {
+
+const std::array<char, 4> MAGIC = {'A', 'S', 'H', 'M'};
+// Bumped whenever the layout, Vertex or the import changes, older files are
+// re-cooked
+const uint32_t VERSION = 4;
+
+struct Header {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t submeshCount;
+
+    // Byte ranges in the file, the submesh table follows the header
+    uint64_t vertexOffset;
+    uint64_t vertexSize;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+};
+
+struct Submesh {
+    // Into the vertex and index blobs
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+
+    // Offsets of null terminated strings in the string table. The texture's
+    // name is appended to the model's, an empty one draws with "white"
+    uint32_t textureName;
+    uint32_t texturePath;
+
+    Bounds bounds;
+};
+
+// An imported model in the order it's written out
+struct Model {
+    std::vector<Submesh> submeshes;
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+    // Starts with an empty string
+    std::string strings{'\0'};
+
+    void addSubmesh(const std::vector<Vertex>& vertices,
+                    const std::vector<uint32_t>& indices,
+                    const std::string& textureName,
+                    const std::string& texturePath);
+};
+
+// Where the cooked version of a source model is written
+std::string cookedPath(const std::string& path);
+
+std::vector<uint8_t> serialize(const Model& model);
+bool save(const std::string& path, const std::vector<uint8_t>& data);
+
+// Creates the meshes, textures and model from a cooked file. Texture paths
+// are relative to directory. Returns false for files of another version
+bool load(const std::string& name, const std::string& directory,
+          const uint8_t* data, size_t size);
+bool load(const std::string& name, const std::string& path);
+
+}  // namespace MeshFile
+
+}  // namespace Ash
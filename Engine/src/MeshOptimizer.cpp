@@ -0,0 +1,315 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+
+namespace Ash::MeshOptimizer {
+
+namespace {
+
+// Forsyth's suggested weights for a 32 entry LRU cache
+const uint32_t SCORING_CACHE_SIZE = 32;
+const uint32_t MAX_SCORED_VALENCE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// Roughly the post-transform cache of current GPUs, used to find clusters
+const uint32_t CLUSTER_CACHE_SIZE = 16;
+
+const uint32_t UNUSED = ~0u;
+
+// A FIFO cache where a vertex is cached while it was added at most cacheSize
+// misses ago, so flushing it is a matter of advancing the time
+class CacheSimulator {
+   public:
+    CacheSimulator(size_t vertexCount, uint32_t cacheSize)
+        : timestamps(vertexCount, 0),
+          cacheSize(cacheSize),
+          time(cacheSize + 1) {}
+
+    uint32_t add(const uint32_t* triangle) {
+        uint32_t misses = 0;
+        for (int c = 0; c < 3; c++) {
+            uint32_t& timestamp = timestamps[triangle[c]];
+            if (time - timestamp > cacheSize) {
+                timestamp = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void flush() { time += cacheSize + 1; }
+
+   private:
+    std::vector<uint32_t> timestamps;
+    uint32_t cacheSize;
+    uint32_t time;
+};
+
+}  // namespace
+
+CacheStats analyzeVertexCache(const std::vector<uint32_t>& indices,
+                              size_t vertexCount, uint32_t cacheSize) {
+    CacheStats stats;
+    stats.triangles = indices.size() / 3;
+
+    CacheSimulator cache(vertexCount, cacheSize);
+    for (size_t t = 0; t < stats.triangles; t++)
+        stats.transformed += cache.add(&indices[t * 3]);
+
+    std::vector<bool> used(vertexCount, false);
+    for (uint32_t index : indices) {
+        if (!used[index]) stats.vertices++;
+        used[index] = true;
+    }
+
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // Scores by position in the cache, the last entry for vertices outside
+    // of it, and by the number of triangles left to draw
+    std::array<float, SCORING_CACHE_SIZE + 1> cacheScores{};
+    for (uint32_t i = 0; i < SCORING_CACHE_SIZE; i++) {
+        // The last triangle's vertices score the same, otherwise it would
+        // matter which order they were added in
+        if (i < 3)
+            cacheScores[i] = LAST_TRIANGLE_SCORE;
+        else
+            cacheScores[i] = std::pow(
+                1.0f - float(i - 3) / (SCORING_CACHE_SIZE - 3),
+                CACHE_DECAY_POWER);
+    }
+    std::array<float, MAX_SCORED_VALENCE + 1> valenceScores{};
+    for (uint32_t i = 1; i <= MAX_SCORED_VALENCE; i++)
+        valenceScores[i] =
+            VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+
+    auto vertexScore = [&](uint32_t position, uint32_t valence) {
+        // Vertices with nothing left to draw shouldn't attract triangles
+        if (valence == 0) return -1.0f;
+        return cacheScores[position] +
+               valenceScores[std::min(valence, MAX_SCORED_VALENCE)];
+    };
+
+    // The triangles left to draw using each vertex, packed into one array
+    std::vector<uint32_t> valences(vertexCount, 0);
+    for (uint32_t index : indices) valences[index]++;
+
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    std::partial_sum(valences.begin(), valences.end(),
+                     firstTriangle.begin() + 1);
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<uint32_t> cachePositions(vertexCount, SCORING_CACHE_SIZE);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScores[v] = vertexScore(SCORING_CACHE_SIZE, valences[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScores[t] = vertexScores[indices[t * 3]] +
+                            vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+
+    // Updates a vertex's score and the scores of the triangles using it
+    auto rescore = [&](uint32_t v) {
+        float score = vertexScore(cachePositions[v], valences[v]);
+        float delta = score - vertexScores[v];
+        vertexScores[v] = score;
+
+        for (uint32_t i = 0; i < valences[v]; i++)
+            triangleScores[adjacency[firstTriangle[v] + i]] += delta;
+    };
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(SCORING_CACHE_SIZE + 3);
+    nextCache.reserve(SCORING_CACHE_SIZE + 3);
+
+    std::vector<uint32_t> ordered;
+    ordered.reserve(indices.size());
+
+    size_t best = 0;
+    size_t cursor = 0;
+    while (ordered.size() < indices.size()) {
+        const uint32_t* triangle = &indices[best * 3];
+        ordered.insert(ordered.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = triangle[c];
+            uint32_t* begin = &adjacency[firstTriangle[v]];
+            uint32_t* end = begin + valences[v];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            valences[v]--;
+        }
+
+        // The triangle's vertices move to the front, the rest keep their
+        // order and whatever falls off the end leaves the cache
+        nextCache.clear();
+        for (int c = 0; c < 3; c++)
+            if (std::find(nextCache.begin(), nextCache.end(), triangle[c]) ==
+                nextCache.end())
+                nextCache.push_back(triangle[c]);
+        for (uint32_t v : cache)
+            if (std::find(triangle, triangle + 3, v) == triangle + 3)
+                nextCache.push_back(v);
+
+        for (size_t i = SCORING_CACHE_SIZE; i < nextCache.size(); i++) {
+            cachePositions[nextCache[i]] = SCORING_CACHE_SIZE;
+            rescore(nextCache[i]);
+        }
+        nextCache.resize(
+            std::min<size_t>(nextCache.size(), SCORING_CACHE_SIZE));
+        std::swap(cache, nextCache);
+
+        for (uint32_t i = 0; i < cache.size(); i++) {
+            cachePositions[cache[i]] = i;
+            rescore(cache[i]);
+        }
+
+        // Only triangles touching the cache can have gained score
+        float bestScore = -1.0f;
+        best = triangleCount;
+        for (uint32_t v : cache) {
+            for (uint32_t i = 0; i < valences[v]; i++) {
+                uint32_t t = adjacency[firstTriangle[v] + i];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        // Nothing in the cache has triangles left, carry on in source order
+        if (best == triangleCount) {
+            while (cursor < triangleCount && emitted[cursor]) cursor++;
+            best = cursor;
+        }
+    }
+
+    indices = std::move(ordered);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // A new cluster starts wherever the cache was effectively flushed, as
+    // moving those costs nothing
+    std::vector<size_t> hardBoundaries;
+    CacheSimulator cache(vertices.size(), CLUSTER_CACHE_SIZE);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (cache.add(&indices[t * 3]) == 3) hardBoundaries.push_back(t);
+    hardBoundaries.push_back(triangleCount);
+
+    // Within those, a new cluster starts once the current one has reached
+    // threshold times the ACMR of the whole. Each starts with an empty cache
+    // since the clusters are drawn in another order
+    std::vector<size_t> clusters;
+    for (size_t i = 0; i + 1 < hardBoundaries.size(); i++) {
+        size_t start = hardBoundaries[i], end = hardBoundaries[i + 1];
+
+        cache.flush();
+        size_t misses = 0;
+        for (size_t t = start; t < end; t++)
+            misses += cache.add(&indices[t * 3]);
+        float target = threshold * misses / (end - start);
+
+        clusters.push_back(start);
+        cache.flush();
+        misses = 0;
+        for (size_t t = start; t < end; t++) {
+            misses += cache.add(&indices[t * 3]);
+            if (t + 1 < end && misses <= target * (t + 1 - clusters.back())) {
+                clusters.push_back(t + 1);
+                cache.flush();
+                misses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Area weighted centroids and normals, the normal's length is twice the
+    // area of the triangles
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].pos;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].pos;
+
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(normal);
+            centroids[c] += (a + b + d) * (triangleArea / 3.0f);
+            normals[c] += normal;
+            area += triangleArea;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += area;
+        if (area > 0.0f) centroids[c] /= area;
+    }
+    if (meshArea == 0.0f) return;
+    meshCentroid /= meshArea;
+
+    // Clusters far out along their normal are likely in front of the rest
+    std::vector<float> keys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float length = glm::length(normals[c]);
+        if (length > 0.0f)
+            keys[c] =
+                glm::dot(centroids[c] - meshCentroid, normals[c]) / length;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> ordered;
+    ordered.reserve(indices.size());
+    for (size_t c : order)
+        ordered.insert(ordered.end(), indices.begin() + clusters[c] * 3,
+                       indices.begin() + clusters[c + 1] * 3);
+
+    indices = std::move(ordered);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(ordered);
+}
+
+}  // namespace Ash::MeshOptimizer
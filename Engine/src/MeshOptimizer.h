@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Helper.h"
+
+namespace Ash {
+
+// Reorders imported meshes so that they render faster without changing what
+// is drawn. Run in this order: the overdraw pass keeps most of the vertex
+// cache order and the fetch pass follows the final index order
+namespace MeshOptimizer {
+
+struct CacheStats {
+    size_t transformed = 0;
+    size_t triangles = 0;
+    // Distinct vertices referenced by the indices
+    size_t vertices = 0;
+
+    // Vertices transformed per triangle, 0.5 at best and 3 at worst
+    float acmr() const {
+        return triangles ? static_cast<float>(transformed) / triangles : 0.0f;
+    }
+    // Vertices transformed per vertex used, 1 at best
+    float atvr() const {
+        return vertices ? static_cast<float>(transformed) / vertices : 0.0f;
+    }
+
+    CacheStats& operator+=(const CacheStats& other) {
+        transformed += other.transformed;
+        triangles += other.triangles;
+        vertices += other.vertices;
+        return *this;
+    }
+};
+
+// Simulates a FIFO post-transform cache of the given size
+CacheStats analyzeVertexCache(const std::vector<uint32_t>& indices,
+                              size_t vertexCount, uint32_t cacheSize = 16);
+
+// Forsyth's linear-speed ordering, which greedily picks the triangle whose
+// vertices are most recently used and have the fewest triangles left
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Splits the triangles into clusters that cost at most threshold times the
+// vertex cache misses and draws the outward facing clusters first, so they
+// occlude the rest of the mesh
+void optimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<Vertex>& vertices,
+                      float threshold = 1.05f);
+
+// Stores vertices in the order they are first used and drops unused ones
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<uint32_t>& indices);
+
+}  // namespace MeshOptimizer
+
+}  // namespace Ash
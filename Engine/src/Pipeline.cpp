@@ -3,8 +3,9 @@
 namespace Ash {
 
 Pipeline::Pipeline(const std::string& vert, const std::string& frag,
-                   const std::string& name) {
+                   const std::string& name, bool pushConstants) {
     this->name = name;
+    this->pushConstants = pushConstants;
 
     paths.push_back(vert);
     paths.push_back(frag);
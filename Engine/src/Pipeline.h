@@ -10,12 +10,18 @@ enum ShaderStages { VERTEX_SHADER_STAGE, FRAGMENT_SHADER_STAGE };
 class Pipeline {
    public:
     Pipeline(const std::string& vert, const std::string& frag,
-             const std::string& name);
+             const std::string& name, bool pushConstants = false);
     ~Pipeline();
 
     std::vector<std::string> paths;
     std::vector<Ash::ShaderStages> stages;
     std::string name;
+
+    // Passes every instance's model matrix to the vertex shader as a push
+    // constant instead of through the object buffer, see push.vert. Each
+    // instance is drawn on its own and these draws are recorded every frame,
+    // so it only pays off for small or highly dynamic scenes
+    bool pushConstants;
 };
 
 }  // namespace Ash
@@ -0,0 +1,89 @@
+#include "RenderQueue.h"
+
+#include <array>
+
+namespace Ash {
+
+uint64_t RenderQueue::makeKey(uint32_t pipeline, uint32_t texture,
+                              uint32_t mesh) {
+    return (static_cast<uint64_t>(pipeline & 0xFFFF) << 48) |
+           (static_cast<uint64_t>(texture & 0xFFFFFF) << 24) |
+           static_cast<uint64_t>(mesh & 0xFFFFFF);
+}
+
+void RenderQueue::clear() {
+    draws.clear();
+    instances.clear();
+}
+
+void RenderQueue::push(const DrawCall& draw) { draws.push_back(draw); }
+
+uint32_t RenderQueue::addInstance(entt::entity entity) {
+    instances.push_back(entity);
+    return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void RenderQueue::sort() {
+    const size_t count = draws.size();
+    if (count < 2) return;
+
+    entries.resize(count);
+    scratch.resize(count);
+
+    // Histogram all 8 digits in a single pass over the keys
+    std::array<std::array<uint32_t, 256>, 8> histograms{};
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = {draws[i].key, static_cast<uint32_t>(i)};
+        for (size_t pass = 0; pass < 8; pass++)
+            histograms[pass][(draws[i].key >> (pass * 8)) & 0xFF]++;
+    }
+
+    // LSD radix sort, stable so equal keys keep their submission order
+    for (size_t pass = 0; pass < 8; pass++) {
+        const uint32_t shift = static_cast<uint32_t>(pass * 8);
+        std::array<uint32_t, 256>& histogram = histograms[pass];
+
+        // Every key shares this digit, the pass wouldn't move anything
+        if (histogram[(entries[0].key >> shift) & 0xFF] == count) continue;
+
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram) {
+            uint32_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+
+        for (const SortEntry& entry : entries)
+            scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+
+        entries.swap(scratch);
+    }
+
+    sorted.resize(count);
+    for (size_t i = 0; i < count; i++) sorted[i] = draws[entries[i].index];
+    draws.swap(sorted);
+}
+
+bool RenderQueue::batch() {
+    previousBatches.swap(batches);
+    batches.clear();
+
+    for (uint32_t i = 0; i < draws.size(); i++) {
+        const DrawCall& draw = draws[i];
+        if (!batches.empty()) {
+            DrawBatch& last = batches.back();
+            if (last.pipeline == draw.pipeline &&
+                last.textureSet == draw.textureSet) {
+                last.drawCount++;
+                continue;
+            }
+        }
+
+        batches.push_back(
+            {draw.pipeline, draw.textureSet, draw.pushConstants, i, 1});
+    }
+
+    return batches != previousBatches;
+}
+
+}  // namespace Ash
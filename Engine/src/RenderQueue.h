@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Helper.h"
+
+namespace Ash {
+
+struct DrawCall {
+    uint64_t key;
+
+    VkPipeline pipeline;
+    VkDescriptorSet textureSet;
+    bool pushConstants;
+
+    // The mesh's place in the shared vertex and index buffers
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    // Turns compressed positions back into mesh space, read by the vertex
+    // shader from the per-draw buffer
+    glm::vec3 positionScale;
+    glm::vec3 positionOffset;
+
+    // Entities sharing a model and pipeline occupy consecutive slots in the
+    // object buffer and are drawn together
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// A run of sorted draws that share all of their bound state. Every mesh
+// lives in the same buffers, so draws of different meshes can share a batch
+struct DrawBatch {
+    VkPipeline pipeline;
+    VkDescriptorSet textureSet;
+    bool pushConstants;
+
+    uint32_t firstDraw;
+    uint32_t drawCount;
+
+    bool operator==(const DrawBatch& other) const = default;
+};
+
+struct RenderStats {
+    uint32_t draws = 0;
+    uint32_t instances = 0;
+    uint32_t binds = 0;
+    uint32_t skippedBinds = 0;
+    float recordMilliseconds = 0.0f;
+
+    // Instances drawn with push constants, recorded every frame
+    uint32_t pushConstantDraws = 0;
+
+    // Only counted when culling on the CPU
+    uint32_t visibleInstances = 0;
+
+    // Dynamic objects written to the object ring last frame, only the ones
+    // that moved unless the draw list changed
+    uint32_t uploadedObjects = 0;
+
+    // Instances and draws that fit in the GPU buffers before they grow
+    uint32_t instanceCapacity = 0;
+    uint32_t drawCapacity = 0;
+};
+
+// Collects the draws of a scene and orders them so that draws sharing a
+// pipeline, texture and mesh end up next to each other
+class RenderQueue {
+   public:
+    // Most significant bits first: 16 bits pipeline, 24 bits texture,
+    // 24 bits mesh
+    static uint64_t makeKey(uint32_t pipeline, uint32_t texture,
+                            uint32_t mesh);
+
+    void clear();
+    void push(const DrawCall& draw);
+    uint32_t addInstance(entt::entity entity);
+    void sort();
+
+    // Groups the sorted draws into batches, returns true if the batches differ
+    // from the previous call
+    bool batch();
+
+    const std::vector<DrawCall>& getDraws() const { return draws; }
+    const std::vector<DrawBatch>& getBatches() const { return batches; }
+    const std::vector<entt::entity>& getInstances() const { return instances; }
+
+   private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawCall> draws;
+    std::vector<entt::entity> instances;
+    std::vector<DrawBatch> batches;
+    std::vector<DrawBatch> previousBatches;
+
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    std::vector<DrawCall> sorted;
+};
+
+}  // namespace Ash
@@ -8,6 +8,8 @@ std::unordered_map<std::string, Mesh> Renderer::meshes;
 std::shared_ptr<Scene> Renderer::scene;
 std::unordered_map<std::string, Texture> Renderer::textures;
 std::unordered_map<std::string, Model> Renderer::models;
+std::vector<uint32_t> Renderer::freeMeshIds;
+uint32_t Renderer::nextMeshId = 0;
 
 void Renderer::loadModel(const std::string& name,
                          const std::vector<std::string>& meshes,
@@ -22,16 +24,71 @@ void Renderer::loadPipeline(const Pipeline& pipeline) {
 void Renderer::loadMesh(const std::string& name,
                         const std::vector<Vertex>& verts,
                         const std::vector<uint32_t>& indices) {
-    meshes[name] = {name, api->createIndexedVertexArray(verts, indices)};
+    uint32_t id = acquireMeshId(name);
+    api->destroyIndexedVertexArray(meshes[name].ivb);
+    Bounds bounds = Helper::computeBounds(verts);
+    meshes[name] = {name, id,
+                    api->createIndexedVertexArray(verts, indices, bounds),
+                    bounds};
 }
 
+void Renderer::loadMesh(const std::string& name, const void* verts,
+                        VkDeviceSize vertSize, const uint32_t* indices,
+                        uint32_t numIndices, const Bounds& bounds) {
+    uint32_t id = acquireMeshId(name);
+    api->destroyIndexedVertexArray(meshes[name].ivb);
+    meshes[name] = {
+        name, id,
+        api->createIndexedVertexArray(verts, vertSize, indices, numIndices,
+                                      bounds),
+        bounds};
+}
+
+void Renderer::unloadMesh(const std::string& name) {
+    auto mesh = meshes.find(name);
+    if (mesh == meshes.end()) return;
+
+    api->destroyIndexedVertexArray(mesh->second.ivb);
+    freeMeshIds.push_back(mesh->second.id);
+    meshes.erase(mesh);
+}
+
+uint32_t Renderer::acquireMeshId(const std::string& name) {
+    if (meshes.contains(name)) return meshes[name].id;
+
+    if (freeMeshIds.empty()) return nextMeshId++;
+
+    uint32_t id = freeMeshIds.back();
+    freeMeshIds.pop_back();
+    return id;
+}
+
+void Renderer::compactGeometry() { api->compactGeometry(); }
+
 void Renderer::loadTexture(const std::string& name, const std::string& path) {
     if (textures.contains(name)) {
         ASH_WARN("Texture ID {} already exists, aborting texture loading",
                  name);
         return;
     }
-    api->createTextureImage(path, textures[name]);
+    Texture& texture = textures[name];
+    texture.name = name;
+    texture.id = static_cast<uint32_t>(textures.size() - 1);
+    api->createTextureImage(path, texture);
+}
+
+void Renderer::loadTextureAsync(const std::string& name,
+                                const std::string& path) {
+    if (textures.contains(name)) {
+        ASH_WARN("Texture ID {} already exists, aborting texture loading",
+                 name);
+        return;
+    }
+    Texture& texture = textures[name];
+    texture.name = name;
+    texture.id = static_cast<uint32_t>(textures.size() - 1);
+    texture.descriptorSet = textures["white"].descriptorSet;
+    api->loadTextureAsync(path, texture);
 }
 
 void Renderer::init() {
@@ -39,7 +96,10 @@ void Renderer::init() {
     loadTexture("white", "assets/textures/white.png");
 }
 
-void Renderer::render() { api->render(); }
+void Renderer::render() {
+    if (scene) scene->updateTransforms();
+    api->render();
+}
 
 void Renderer::cleanup() { api->cleanup(); }
 
@@ -47,8 +107,32 @@ void Renderer::setClearColor(const glm::vec4& clearColor) {
     api->setClearColor(clearColor);
 }
 
+void Renderer::setRecordingThreads(uint32_t count) {
+    api->setRecordingThreads(count);
+}
+
+void Renderer::setIndirectDrawing(bool enabled) {
+    api->setIndirectDrawing(enabled);
+}
+
+void Renderer::setCullingMode(CullingMode mode) {
+    api->setCullingMode(mode);
+}
+
+void Renderer::setVertexCompression(bool enabled) {
+    api->setVertexCompression(enabled);
+}
+
+void Renderer::setMainPushConstants(bool enabled) {
+    api->setMainPushConstants(enabled);
+}
+
+const RenderStats& Renderer::getStats() { return api->getStats(); }
+
 void Renderer::setScene(std::shared_ptr<Scene> scene) {
+    if (Renderer::scene) api->untrackScene(*Renderer::scene);
     Renderer::scene = scene;
+    if (scene) api->trackScene(*scene);
 }
 
 }  // namespace Ash
@@ -29,6 +29,9 @@ class Renderer {
     static Texture& getTexture(const std::string& name) {
         return textures[name];
     }
+    static bool hasTexture(const std::string& name) {
+        return textures.contains(name);
+    }
 
     static void loadModel(const std::string& name,
                           const std::vector<std::string>& meshes,
@@ -37,14 +40,33 @@ class Renderer {
     static void loadMesh(const std::string& name,
                          const std::vector<Vertex>& verts,
                          const std::vector<uint32_t>& indices);
+    // For cooked meshes, whose bounds are already known
+    static void loadMesh(const std::string& name, const void* verts,
+                         VkDeviceSize vertSize, const uint32_t* indices,
+                         uint32_t numIndices, const Bounds& bounds);
+    // No model drawn in the scene may still use the mesh
+    static void unloadMesh(const std::string& name);
+    // Packs the remaining meshes together after many have been unloaded
+    static void compactGeometry();
 
     static void loadTexture(const std::string& name, const std::string& path);
 
+    // Returns right away, the texture is drawn as "white" until it has been
+    // decoded and uploaded
+    static void loadTextureAsync(const std::string& name,
+                                 const std::string& path);
+
     static void init();
     static void render();
     static void cleanup();
 
     static void setClearColor(const glm::vec4& clearColor);
+    static void setRecordingThreads(uint32_t count);
+    static void setIndirectDrawing(bool enabled);
+    static void setCullingMode(CullingMode mode);
+    static void setVertexCompression(bool enabled);
+    static void setMainPushConstants(bool enabled);
+    static const RenderStats& getStats();
     static void setScene(std::shared_ptr<Scene> scene);
 
     static inline std::shared_ptr<Scene> getScene() { return scene; }
@@ -61,6 +83,12 @@ class Renderer {
     static std::unordered_map<std::string, Mesh> meshes;
     static std::unordered_map<std::string, Texture> textures;
     static std::unordered_map<std::string, Model> models;
+
+    // Mesh ids are part of the draw sort key, so they are unique among loaded
+    // meshes and reused after an unload to keep them small
+    static uint32_t acquireMeshId(const std::string& name);
+    static std::vector<uint32_t> freeMeshIds;
+    static uint32_t nextMeshId;
 };
 
 }  // namespace Ash
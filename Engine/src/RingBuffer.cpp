@@ -0,0 +1,54 @@
+#include "RingBuffer.h"
+
+#include "Core.h"
+#include "Log.h"
+
+namespace Ash {
+
+void RingBuffer::init(VmaAllocator allocator, VkBuffer buffer,
+                      VmaAllocation allocation, void* mapped,
+                      VkDeviceSize regionSize) {
+    this->allocator = allocator;
+    this->buffer = buffer;
+    this->allocation = allocation;
+    this->mapped = static_cast<uint8_t*>(mapped);
+    this->regionSize = regionSize;
+
+    regionStart = 0;
+    head = 0;
+}
+
+void RingBuffer::destroy() {
+    vmaDestroyBuffer(allocator, buffer, allocation);
+
+    buffer = VK_NULL_HANDLE;
+    allocation = VK_NULL_HANDLE;
+    mapped = nullptr;
+}
+
+void RingBuffer::beginRegion(uint32_t region) {
+    regionStart = region * regionSize;
+    head = regionStart;
+}
+
+RingBuffer::Allocation RingBuffer::allocate(VkDeviceSize size,
+                                            VkDeviceSize alignment) {
+    if (alignment > 1) head = (head + alignment - 1) & ~(alignment - 1);
+
+    ASH_ASSERT(head + size <= regionStart + regionSize,
+               "Ring buffer region overflow, {} bytes requested with {} left",
+               size, regionStart + regionSize - head);
+
+    Allocation result{head, mapped + head};
+    head += size;
+    return result;
+}
+
+void RingBuffer::flush() {
+    // A no-op on host coherent memory
+    if (head > regionStart)
+        vmaFlushAllocation(allocator, allocation, regionStart,
+                           head - regionStart);
+}
+
+}  // namespace Ash
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace Ash {
+
+// A persistently mapped buffer split into one region per frame in flight.
+// Every frame bump allocates from its own region, which is only handed out
+// again once the frame's fence has been waited on
+class RingBuffer {
+   public:
+    struct Allocation {
+        VkDeviceSize offset;
+        void* data;
+    };
+
+    void init(VmaAllocator allocator, VkBuffer buffer, VmaAllocation allocation,
+              void* mapped, VkDeviceSize regionSize);
+    void destroy();
+
+    // Resets the region to empty, the caller must make sure the GPU is done
+    // with it
+    void beginRegion(uint32_t region);
+    Allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+    // Makes everything allocated in the current region visible to the device
+    void flush();
+
+    VkBuffer getBuffer() const { return buffer; }
+    VmaAllocation getAllocation() const { return allocation; }
+    VkDeviceSize getRegionSize() const { return regionSize; }
+
+   private:
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    uint8_t* mapped = nullptr;
+
+    VkDeviceSize regionSize = 0;
+    VkDeviceSize regionStart = 0;
+    VkDeviceSize head = 0;
+};
+
+}  // namespace Ash
@@ -1,14 +1,64 @@
 #include "Scene.h"
 
+#include <algorithm>
+
+#include "Components.h"
+
 namespace Ash {
 
-Scene::Scene() {}
-Scene::~Scene() {}
+Scene::Scene() { transforms.connect(registry); }
+Scene::~Scene() { transforms.disconnect(registry); }
 
 Entity Scene::spawn() { return Entity(registry.create()); }
 
 void Scene::destroyEntity(Entity entity) {
-    registry.destroy(entity.getHandle());
+    entt::entity handle = entity.getHandle();
+    detach(handle);
+
+    // Orphans become roots
+    if (Children* children = registry.try_get<Children>(handle)) {
+        for (entt::entity child : children->entities)
+            registry.remove<Parent>(child);
+    }
+
+    registry.destroy(handle);
+}
+
+void Scene::setParent(Entity child, Entity parent) {
+    entt::entity handle = child.getHandle();
+    entt::entity parentHandle = parent.getHandle();
+
+    for (entt::entity ancestor = parentHandle; ancestor != entt::null;) {
+        ASH_ASSERT(ancestor != handle, "Parenting would create a cycle");
+        Parent* next = registry.try_get<Parent>(ancestor);
+        ancestor = next ? next->entity : entt::null;
+    }
+
+    detach(handle);
+    if (parentHandle == entt::null) return;
+
+    registry.get_or_emplace<Children>(parentHandle)
+        .entities.push_back(handle);
+    registry.emplace<Parent>(handle, parentHandle);
+}
+
+void Scene::updateTransforms() { transforms.update(registry); }
+
+void Scene::detach(entt::entity child) {
+    Parent* parent = registry.try_get<Parent>(child);
+    if (!parent) return;
+
+    // The parent may already be gone, or have lost its Children
+    Children* children = registry.valid(parent->entity)
+                             ? registry.try_get<Children>(parent->entity)
+                             : nullptr;
+    if (children) {
+        std::vector<entt::entity>& siblings = children->entities;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), child),
+                       siblings.end());
+    }
+
+    registry.remove<Parent>(child);
 }
 
 }  // namespace Ash
@@ -4,6 +4,7 @@
 #include "Core.h"
 #include "Entity.h"
 #include "Log.h"
+#include "TransformSystem.h"
 
 namespace Ash {
 
@@ -15,17 +16,25 @@ class Scene {
     Entity spawn();
     void destroyEntity(Entity entity);
 
+    // Makes the child's transform relative to the parent's, a null parent
+    // detaches it
+    void setParent(Entity child, Entity parent);
+
+    // Recomputes the world transforms of everything that moved
+    void updateTransforms();
+    TransformSystem& getTransformSystem() { return transforms; }
+
     template <typename T>
     bool hasComponent(Entity entity) {
         return registry.has<T>(entity.getHandle());
     }
 
+    // Returns the component, or nothing for empty tags like Static
     template <typename T, typename... Args>
-    T& addComponent(Entity entity, Args&&... args) {
+    decltype(auto) addComponent(Entity entity, Args&&... args) {
         ASH_ASSERT(!hasComponent<T>(entity), "Entity already has component");
-        T& comp = registry.emplace<T>(entity.getHandle(),
-                                      std::forward<Args>(args)...);
-        return comp;
+        return registry.emplace<T>(entity.getHandle(),
+                                   std::forward<Args>(args)...);
     }
 
     template <typename T>
@@ -42,6 +51,11 @@ class Scene {
     // TODO: Systems?
 
     entt::registry registry;
+
+   private:
+    void detach(entt::entity child);
+
+    TransformSystem transforms;
 };
 
 }  // namespace Ash
@@ -0,0 +1,26 @@
+#pragma once
+
+// Widest float vector the target was compiled for, AVX only with ASH_AVX.
+// ASH_SCALAR forces the plain C++ paths, for comparing against them
+#if defined(ASH_SCALAR)
+#define ASH_SIMD_WIDTH 1
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define ASH_SIMD_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ASH_SIMD_WIDTH 4
+#else
+#define ASH_SIMD_WIDTH 1
+#endif
+
+// Code built on the width is declared in a namespace named after it, so that
+// copies built for different widths can be linked into one program
+#if ASH_SIMD_WIDTH == 8
+#define ASH_SIMD_NAMESPACE avx
+#elif ASH_SIMD_WIDTH == 4
+#define ASH_SIMD_NAMESPACE sse
+#else
+#define ASH_SIMD_NAMESPACE scalar
+#endif
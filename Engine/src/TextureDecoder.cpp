@@ -0,0 +1,103 @@
+#include "TextureDecoder.h"
+
+#include <stb_image.h>
+
+#include "Archive.h"
+
+namespace Ash {
+
+TextureDecoder::~TextureDecoder() { stop(); }
+
+void TextureDecoder::start(uint32_t threads) {
+    stopping = false;
+    for (uint32_t i = 0; i < threads; i++)
+        workers.emplace_back(&TextureDecoder::work, this);
+}
+
+void TextureDecoder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queued.clear();
+    }
+    condition.notify_all();
+
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+
+    for (Image& image : finished) release(image);
+    finished.clear();
+}
+
+void TextureDecoder::push(const std::string& name, const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back({name, path});
+    }
+    condition.notify_one();
+}
+
+void TextureDecoder::collect(std::vector<Image>& decoded) {
+    std::lock_guard<std::mutex> lock(mutex);
+    decoded.insert(decoded.end(), finished.begin(), finished.end());
+    finished.clear();
+}
+
+void TextureDecoder::release(Image& image) {
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.ktx = {};
+}
+
+void TextureDecoder::work() {
+    while (true) {
+        Image image;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] { return stopping || !queued.empty(); });
+            if (stopping) return;
+
+            image = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        decode(image);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(image));
+    }
+}
+
+void TextureDecoder::decode(Image& image) {
+    // Mounted archives hold KTX2 files in place of the images they were
+    // cooked from
+    const Archive::Entry* entry = Archive::find(image.path);
+    if (entry && entry->type == Archive::Type::Texture) {
+        if (!Ktx::load(image.path, entry->data, entry->size, image.ktx))
+            image.ktx = {};
+    } else if (!entry && Ktx::isKtx2(image.path)) {
+        if (!Ktx::load(image.path, image.ktx)) image.ktx = {};
+    }
+
+    if (image.isCompressed()) {
+        image.width = image.ktx.width;
+        image.height = image.ktx.height;
+        return;
+    }
+
+    int width, height, channels;
+    if (entry)
+        image.pixels = stbi_load_from_memory(
+            entry->data, static_cast<int>(entry->size), &width, &height,
+            &channels, STBI_rgb_alpha);
+    else if (!Ktx::isKtx2(image.path))
+        image.pixels = stbi_load(image.path.c_str(), &width, &height,
+                                 &channels, STBI_rgb_alpha);
+
+    if (image.pixels) {
+        image.width = static_cast<uint32_t>(width);
+        image.height = static_cast<uint32_t>(height);
+    }
+}
+
+}  // namespace Ash
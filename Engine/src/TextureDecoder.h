@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Ktx.h"
+
+namespace Ash {
+
+// Decodes image files into RGBA8 pixels on a pool of worker threads so that
+// loading textures never blocks the render loop. KTX2 files are read as-is
+class TextureDecoder {
+   public:
+    struct Image {
+        std::string name;
+        std::string path;
+
+        // Null if the file couldn't be decoded, freed with release
+        uint8_t* pixels = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        // Holds the levels of KTX2 files instead of pixels
+        Ktx::Image ktx{};
+
+        bool isCompressed() const { return !ktx.levels.empty(); }
+        bool isLoaded() const { return pixels || isCompressed(); }
+        size_t size() const {
+            return isCompressed() ? ktx.data.size()
+                                  : size_t(width) * height * 4;
+        }
+    };
+
+    ~TextureDecoder();
+
+    void start(uint32_t threads);
+    // Waits for the images being decoded and drops the queued ones
+    void stop();
+
+    void push(const std::string& name, const std::string& path);
+
+    // Moves every image that has finished decoding to the end of decoded
+    void collect(std::vector<Image>& decoded);
+
+    // Decodes on the calling thread, from the mounted archive if it holds
+    // the image
+    static void decode(Image& image);
+    static void release(Image& image);
+
+    bool isRunning() const { return !workers.empty(); }
+
+   private:
+    void work();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Image> queued;
+    std::vector<Image> finished;
+    bool stopping = false;
+};
+
+}  // namespace Ash
@@ -0,0 +1,200 @@
+#include "TransformBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Simd.h"
+
+namespace Ash {
+
+namespace {
+
+// Wrapped in a struct so the arithmetic reads the same for every width
+#if ASH_SIMD_WIDTH == 8
+struct Float {
+    __m256 v;
+};
+inline Float load(const float* p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float* p, Float a) { _mm256_storeu_ps(p, a.v); }
+inline Float splat(float f) { return {_mm256_set1_ps(f)}; }
+inline Float operator+(Float a, Float b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Float operator&(Float a, Float b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline Float operator^(Float a, Float b) { return {_mm256_xor_ps(a.v, b.v)}; }
+inline Float greater(Float a, Float b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+}
+inline Float select(Float mask, Float a, Float b) {
+    return {_mm256_or_ps(_mm256_and_ps(mask.v, a.v),
+                         _mm256_andnot_ps(mask.v, b.v))};
+}
+#elif ASH_SIMD_WIDTH == 4
+struct Float {
+    __m128 v;
+};
+inline Float load(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store(float* p, Float a) { _mm_storeu_ps(p, a.v); }
+inline Float splat(float f) { return {_mm_set1_ps(f)}; }
+inline Float operator+(Float a, Float b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float operator&(Float a, Float b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Float operator^(Float a, Float b) { return {_mm_xor_ps(a.v, b.v)}; }
+inline Float greater(Float a, Float b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Float select(Float mask, Float a, Float b) {
+    return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+#else
+using Float = float;
+inline Float load(const float* p) { return *p; }
+inline void store(float* p, Float a) { *p = a; }
+inline Float splat(float f) { return f; }
+#endif
+
+#if ASH_SIMD_WIDTH > 1
+constexpr float PI = 3.14159265358979f;
+constexpr float HALF_PI = 1.57079632679490f;
+constexpr float TWO_PI = 6.28318530717959f;
+
+// Two parts of 2pi, the first exact in few bits, so that subtracting whole
+// turns loses less precision
+constexpr float TWO_PI_HIGH = 6.28125f;
+constexpr float TWO_PI_LOW = 0.00193530717959f;
+
+// Adding and subtracting 1.5 * 2^23 rounds to the nearest integer
+constexpr float ROUND_MAGIC = 12582912.0f;
+
+// Only valid for x in [-pi, pi]
+inline Float sinReduced(Float x) {
+    // sin(x) = sin(pi - x) folds the range onto [-pi/2, pi/2]
+    Float sign = x & splat(-0.0f);
+    Float absX = x ^ sign;
+    absX = select(greater(absX, splat(HALF_PI)), splat(PI) - absX, absX);
+    x = absX ^ sign;
+
+    // Taylor series up to x^11, the error is below 1e-7 on the range
+    Float x2 = x * x;
+    Float p = splat(-1.0f / 39916800.0f);
+    p = p * x2 + splat(1.0f / 362880.0f);
+    p = p * x2 + splat(-1.0f / 5040.0f);
+    p = p * x2 + splat(1.0f / 120.0f);
+    p = p * x2 + splat(-1.0f / 6.0f);
+    return x + x * x2 * p;
+}
+
+inline void sinCos(Float x, Float& s, Float& c) {
+    // Wrap into [-pi, pi]
+    Float turns = x * splat(1.0f / TWO_PI);
+    turns = (turns + splat(ROUND_MAGIC)) - splat(ROUND_MAGIC);
+    x = (x - turns * splat(TWO_PI_HIGH)) - turns * splat(TWO_PI_LOW);
+
+    s = sinReduced(x);
+
+    // cos(x) = sin(x + pi/2), wrapped back into range
+    Float y = x + splat(HALF_PI);
+    y = select(greater(y, splat(PI)), y - splat(TWO_PI), y);
+    c = sinReduced(y);
+}
+#else
+inline void sinCos(Float x, Float& s, Float& c) {
+    s = std::sin(x);
+    c = std::cos(x);
+}
+#endif
+
+}  // namespace
+
+void TransformBatch::clear() {
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    rotationX.clear();
+    rotationY.clear();
+    rotationZ.clear();
+    scaleX.clear();
+    scaleY.clear();
+    scaleZ.clear();
+    outputs.clear();
+}
+
+void TransformBatch::push(const glm::vec3& position, const glm::vec3& rotation,
+                          const glm::vec3& scale, glm::mat4* out) {
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    rotationX.push_back(rotation.x);
+    rotationY.push_back(rotation.y);
+    rotationZ.push_back(rotation.z);
+    scaleX.push_back(scale.x);
+    scaleY.push_back(scale.y);
+    scaleZ.push_back(scale.z);
+    outputs.push_back(out);
+}
+
+void TransformBatch::compose() {
+    const size_t count = outputs.size();
+    if (count == 0) return;
+
+    // Pad to a full register, the padding is computed but never written out
+    const size_t padded =
+        (count + ASH_SIMD_WIDTH - 1) / ASH_SIMD_WIDTH * ASH_SIMD_WIDTH;
+    for (std::vector<float>* values :
+         {&positionX, &positionY, &positionZ, &rotationX, &rotationY,
+          &rotationZ, &scaleX, &scaleY, &scaleZ})
+        values->resize(padded, 0.0f);
+
+    // Columns of every matrix in the register, rows of the last column are
+    // constant
+    float columns[12][ASH_SIMD_WIDTH];
+
+    for (size_t i = 0; i < padded; i += ASH_SIMD_WIDTH) {
+        // Quaternion from Euler angles, as glm::quat(glm::vec3) does
+        Float sx, cx, sy, cy, sz, cz;
+        sinCos(load(&rotationX[i]) * splat(0.5f), sx, cx);
+        sinCos(load(&rotationY[i]) * splat(0.5f), sy, cy);
+        sinCos(load(&rotationZ[i]) * splat(0.5f), sz, cz);
+
+        Float qw = cx * cy * cz + sx * sy * sz;
+        Float qx = sx * cy * cz - cx * sy * sz;
+        Float qy = cx * sy * cz + sx * cy * sz;
+        Float qz = cx * cy * sz - sx * sy * cz;
+
+        // Rotation matrix as glm::toMat4, scaled per column
+        Float two = splat(2.0f);
+        Float one = splat(1.0f);
+        Float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+        Float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+        Float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+
+        Float scaleXs = load(&scaleX[i]);
+        Float scaleYs = load(&scaleY[i]);
+        Float scaleZs = load(&scaleZ[i]);
+
+        store(columns[0], (one - two * (yy + zz)) * scaleXs);
+        store(columns[1], two * (xy + wz) * scaleXs);
+        store(columns[2], two * (xz - wy) * scaleXs);
+        store(columns[3], two * (xy - wz) * scaleYs);
+        store(columns[4], (one - two * (xx + zz)) * scaleYs);
+        store(columns[5], two * (yz + wx) * scaleYs);
+        store(columns[6], two * (xz + wy) * scaleZs);
+        store(columns[7], two * (yz - wx) * scaleZs);
+        store(columns[8], (one - two * (xx + yy)) * scaleZs);
+        store(columns[9], load(&positionX[i]));
+        store(columns[10], load(&positionY[i]));
+        store(columns[11], load(&positionZ[i]));
+
+        size_t lanes = std::min<size_t>(ASH_SIMD_WIDTH, count - i);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            glm::mat4& m = *outputs[i + lane];
+            for (int c = 0; c < 4; c++) {
+                m[c][0] = columns[c * 3][lane];
+                m[c][1] = columns[c * 3 + 1][lane];
+                m[c][2] = columns[c * 3 + 2][lane];
+                m[c][3] = c == 3 ? 1.0f : 0.0f;
+            }
+        }
+    }
+}
+
+}  // namespace Ash
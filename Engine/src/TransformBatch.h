@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Simd.h"
+
+namespace Ash {
+inline namespace ASH_SIMD_NAMESPACE {
+
+// Collects local transforms in a structure of arrays layout and composes
+// their matrices a full SIMD register of transforms at a time
+class TransformBatch {
+   public:
+    void clear();
+
+    // The matrix is written to out by the next compose
+    void push(const glm::vec3& position, const glm::vec3& rotation,
+              const glm::vec3& scale, glm::mat4* out);
+
+    // Computes translate * rotate * scale with rotation as Euler angles, the
+    // same as Transform::getTransform
+    void compose();
+
+    size_t size() const { return outputs.size(); }
+
+   private:
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> rotationX;
+    std::vector<float> rotationY;
+    std::vector<float> rotationZ;
+    std::vector<float> scaleX;
+    std::vector<float> scaleY;
+    std::vector<float> scaleZ;
+
+    std::vector<glm::mat4*> outputs;
+};
+
+}  // namespace ASH_SIMD_NAMESPACE
+}  // namespace Ash
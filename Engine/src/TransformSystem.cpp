@@ -0,0 +1,137 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+
+#include "Components.h"
+
+namespace Ash {
+
+void TransformSystem::connect(entt::registry& registry) {
+    registry.on_construct<Transform>()
+        .connect<&TransformSystem::onHierarchyChanged>(*this);
+    registry.on_destroy<Transform>()
+        .connect<&TransformSystem::onHierarchyChanged>(*this);
+    registry.on_construct<Parent>()
+        .connect<&TransformSystem::onHierarchyChanged>(*this);
+    registry.on_update<Parent>()
+        .connect<&TransformSystem::onHierarchyChanged>(*this);
+    registry.on_destroy<Parent>()
+        .connect<&TransformSystem::onHierarchyChanged>(*this);
+    orderChanged = true;
+}
+
+void TransformSystem::disconnect(entt::registry& registry) {
+    registry.on_construct<Transform>().disconnect(*this);
+    registry.on_destroy<Transform>().disconnect(*this);
+    registry.on_construct<Parent>().disconnect(*this);
+    registry.on_update<Parent>().disconnect(*this);
+    registry.on_destroy<Parent>().disconnect(*this);
+}
+
+void TransformSystem::onHierarchyChanged(entt::registry&, entt::entity) {
+    orderChanged = true;
+}
+
+void TransformSystem::update(entt::registry& registry) {
+    if (orderChanged) rebuild(registry);
+
+    batch.clear();
+    composed = 0;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        Node& node = nodes[i];
+        const Transform& transform = registry.get<Transform>(node.entity);
+
+        // Composing the local matrix is the expensive part, most transforms
+        // don't change from frame to frame
+        bool changed = dirty[i] || transform.position != node.position ||
+                       transform.rotation != node.rotation ||
+                       transform.scale != node.scale;
+        if (!changed) continue;
+
+        node.position = transform.position;
+        node.rotation = transform.rotation;
+        node.scale = transform.scale;
+        dirty[i] = 1;
+        composed++;
+
+        if (batching)
+            batch.push(node.position, node.rotation, node.scale, &node.local);
+        else
+            node.local = transform.getTransform();
+    }
+    batch.compose();
+
+    // Parents come first, so their flags are final before any child reads
+    // them
+    updated = 0;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        Node& node = nodes[i];
+
+        bool parentDirty = node.parent != NO_PARENT && dirty[node.parent];
+        dirty[i] = dirty[i] || parentDirty;
+        if (!dirty[i]) continue;
+
+        node.world = node.parent == NO_PARENT
+                         ? node.local
+                         : nodes[node.parent].world * node.local;
+        // Patched so that listeners like the renderer see what moved
+        registry.patch<WorldTransform>(node.entity, [&](WorldTransform& world) {
+            world.matrix = node.world;
+        });
+        updated++;
+    }
+
+    std::fill(dirty.begin(), dirty.end(), 0);
+}
+
+void TransformSystem::rebuild(entt::registry& registry) {
+    orderChanged = false;
+    nodes.clear();
+
+    // Stale world transforms would otherwise keep being rendered
+    auto stale = registry.view<WorldTransform>(entt::exclude<Transform>);
+    stack.clear();
+    for (auto entity : stale) stack.push_back({entity, NO_PARENT});
+    for (auto [entity, parent] : stack) registry.remove<WorldTransform>(entity);
+
+    // Roots are entities without a transformed parent
+    auto transforms = registry.view<Transform>();
+    for (auto entity : transforms) {
+        Parent* parent = registry.try_get<Parent>(entity);
+        if (parent && registry.valid(parent->entity) &&
+            registry.has<Transform>(parent->entity))
+            continue;
+
+        addSubtree(registry, entity);
+    }
+
+    // Everything is recomputed once after the order changes
+    dirty.assign(nodes.size(), 1);
+}
+
+void TransformSystem::addSubtree(entt::registry& registry, entt::entity root) {
+    stack.clear();
+    stack.push_back({root, NO_PARENT});
+
+    while (!stack.empty()) {
+        auto [entity, parent] = stack.back();
+        stack.pop_back();
+
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({entity, parent});
+        if (!registry.has<WorldTransform>(entity))
+            registry.emplace<WorldTransform>(entity);
+
+        Children* children = registry.try_get<Children>(entity);
+        if (!children) continue;
+
+        // Pushed in reverse so that children are visited in order
+        for (auto it = children->entities.rbegin();
+             it != children->entities.rend(); it++) {
+            if (registry.valid(*it) && registry.has<Transform>(*it))
+                stack.push_back({*it, index});
+        }
+    }
+}
+
+}  // namespace Ash
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "TransformBatch.h"
+
+namespace Ash {
+
+// Keeps the WorldTransform of every entity with a Transform up to date.
+// Entities are stored in depth-first order so that parents are always
+// computed before their children, and only subtrees whose local transforms
+// changed since the last update are recomputed
+class TransformSystem {
+   public:
+    void connect(entt::registry& registry);
+    void disconnect(entt::registry& registry);
+
+    void update(entt::registry& registry);
+
+    // Composes changed local matrices in SIMD batches, on by default. Turning
+    // it off composes them one at a time with Transform::getTransform
+    void setBatching(bool enabled) { batching = enabled; }
+
+    // Number of world matrices recomputed by the last update
+    uint32_t getUpdatedCount() const { return updated; }
+
+    // Number of local matrices composed by the last update
+    uint32_t getComposedCount() const { return composed; }
+
+   private:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    struct Node {
+        entt::entity entity;
+        uint32_t parent;
+
+        // Local transform the cached matrices were composed from
+        glm::vec3 position;
+        glm::vec3 rotation;
+        glm::vec3 scale;
+
+        glm::mat4 local;
+        glm::mat4 world;
+    };
+
+    void onHierarchyChanged(entt::registry& registry, entt::entity entity);
+    void rebuild(entt::registry& registry);
+    void addSubtree(entt::registry& registry, entt::entity root);
+
+    std::vector<Node> nodes;
+    std::vector<uint8_t> dirty;
+    // Entities left to visit and the index of their parent's node
+    std::vector<std::pair<entt::entity, uint32_t>> stack;
+
+    TransformBatch batch;
+    bool batching = true;
+
+    bool orderChanged = true;
+    uint32_t updated = 0;
+    uint32_t composed = 0;
+};
+
+}  // namespace Ash
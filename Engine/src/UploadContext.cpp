@@ -0,0 +1,256 @@
+#include "UploadContext.h"
+
+#include "Core.h"
+#include "Log.h"
+
+namespace Ash {
+
+void UploadContext::init(VkDevice device, VmaAllocator allocator,
+                         VkQueue queue, uint32_t queueFamily,
+                         VkDeviceSize stagingSize, VkDeviceSize alignment) {
+    this->device = device;
+    this->allocator = allocator;
+    this->queue = queue;
+    this->alignment = alignment;
+    // Whole multiples of the alignment keep wrapped offsets aligned
+    ringSize = (stagingSize + alignment - 1) / alignment * alignment;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    ASH_ASSERT(vkCreateCommandPool(device, &poolInfo, nullptr,
+                                   &commandPool) == VK_SUCCESS,
+               "Failed to create upload command pool");
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = ringSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocationInfo{};
+    allocationInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo info{};
+    ASH_ASSERT(vmaCreateBuffer(allocator, &bufferInfo, &allocationInfo, &ring,
+                               &ringAllocation, &info) == VK_SUCCESS,
+               "Failed to create staging ring");
+    mapped = static_cast<uint8_t*>(info.pMappedData);
+}
+
+void UploadContext::destroy() {
+    flush();
+
+    for (Batch& batch : spare) vkDestroyFence(device, batch.fence, nullptr);
+    spare.clear();
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vmaDestroyBuffer(allocator, ring, ringAllocation);
+}
+
+void UploadContext::begin() {
+    if (recording) return;
+
+    if (!spare.empty()) {
+        current = std::move(spare.back());
+        spare.pop_back();
+    } else {
+        current = {};
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(device, &allocInfo, &current.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        ASH_ASSERT(vkCreateFence(device, &fenceInfo, nullptr,
+                                 &current.fence) == VK_SUCCESS,
+                   "Failed to create upload fence");
+    }
+
+    current.id = nextBatch;
+    current.begin = head;
+    current.copies = 0;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(current.commandBuffer, &beginInfo);
+
+    recording = true;
+}
+
+UploadContext::Staging UploadContext::stage(VkDeviceSize size) {
+    begin();
+
+    if (size > ringSize) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocationInfo{};
+        allocationInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+        allocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        VmaAllocationInfo info{};
+        ASH_ASSERT(vmaCreateBuffer(allocator, &bufferInfo, &allocationInfo,
+                                   &buffer, &allocation,
+                                   &info) == VK_SUCCESS,
+                   "Failed to create staging buffer");
+
+        current.dedicated.push_back({buffer, allocation});
+        return {buffer, 0, info.pMappedData};
+    }
+
+    // Never split across the end of the ring
+    uint64_t offset = (head + alignment - 1) / alignment * alignment;
+    if (offset % ringSize + size > ringSize)
+        offset += ringSize - offset % ringSize;
+
+    while (true) {
+        uint64_t tail =
+            inFlight.empty() ? current.begin : inFlight.front().begin;
+        if (offset + size <= tail + ringSize) break;
+
+        if (!inFlight.empty()) {
+            waitOldest();
+            continue;
+        }
+
+        // The batch being recorded fills the ring by itself
+        ASH_TRACE("Staging ring full, flushing {} copies", current.copies);
+        flush();
+        head = (head + ringSize - 1) / ringSize * ringSize;
+        begin();
+        offset = head;
+    }
+
+    head = offset + size;
+    VkDeviceSize ringOffset = offset % ringSize;
+    return {ring, ringOffset, mapped + ringOffset};
+}
+
+void UploadContext::copyBuffer(const Staging& staging, VkBuffer buffer,
+                               VkDeviceSize size, VkDeviceSize offset) {
+    begin();
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = staging.offset;
+    copyRegion.dstOffset = offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(current.commandBuffer, staging.buffer, buffer, 1,
+                    &copyRegion);
+    current.copies++;
+}
+
+void UploadContext::copyBufferToImage(const Staging& staging, VkImage image,
+                                      uint32_t width, uint32_t height,
+                                      uint32_t mipLevel) {
+    begin();
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = staging.offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mipLevel;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {width, height, 1};
+
+    vkCmdCopyBufferToImage(current.commandBuffer, staging.buffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    current.copies++;
+}
+
+VkCommandBuffer UploadContext::getCommandBuffer() {
+    begin();
+    return current.commandBuffer;
+}
+
+bool UploadContext::isComplete(uint64_t batch) {
+    poll();
+    return batch <= completed;
+}
+
+void UploadContext::submit() {
+    poll();
+    if (!recording) return;
+
+    // Barriers cover everything later in submission order, so frames
+    // submitted after this batch read its writes without a semaphore
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+
+    vkEndCommandBuffer(current.commandBuffer);
+
+    // A no-op on host coherent memory
+    vmaFlushAllocation(allocator, ringAllocation, 0, VK_WHOLE_SIZE);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &current.commandBuffer;
+
+    vkResetFences(device, 1, &current.fence);
+    ASH_ASSERT(vkQueueSubmit(queue, 1, &submitInfo, current.fence) ==
+                   VK_SUCCESS,
+               "Failed to submit uploads");
+
+    if (current.copies > 0)
+        ASH_TRACE("Submitted {} copies in upload batch {}", current.copies,
+                  current.id);
+
+    inFlight.push_back(std::move(current));
+    recording = false;
+    nextBatch++;
+}
+
+void UploadContext::flush() {
+    submit();
+    while (!inFlight.empty()) waitOldest();
+}
+
+void UploadContext::poll() {
+    while (!inFlight.empty() &&
+           vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS) {
+        retire(inFlight.front());
+        inFlight.pop_front();
+    }
+}
+
+void UploadContext::waitOldest() {
+    vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, UINT64_MAX);
+    retire(inFlight.front());
+    inFlight.pop_front();
+}
+
+void UploadContext::retire(Batch& batch) {
+    for (auto [buffer, allocation] : batch.dedicated)
+        vmaDestroyBuffer(allocator, buffer, allocation);
+    batch.dedicated.clear();
+
+    completed = batch.id;
+    spare.push_back(std::move(batch));
+}
+
+}  // namespace Ash
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace Ash {
+
+// Records copies and layout transitions into one command buffer per batch,
+// staged through a persistently mapped ring. Batches are submitted once per
+// frame with a fence instead of waiting for the queue to go idle after every
+// copy. Each batch ends in a barrier, so anything submitted to the queue
+// afterwards sees its writes
+class UploadContext {
+   public:
+    struct Staging {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        void* data;
+    };
+
+    void init(VkDevice device, VmaAllocator allocator, VkQueue queue,
+              uint32_t queueFamily, VkDeviceSize stagingSize,
+              VkDeviceSize alignment);
+    void destroy();
+
+    // Space for size bytes that stays valid until the batch has completed.
+    // Blocks on older batches when the ring is full, requests larger than
+    // the ring get a buffer of their own
+    Staging stage(VkDeviceSize size);
+
+    void copyBuffer(const Staging& staging, VkBuffer buffer, VkDeviceSize size,
+                    VkDeviceSize offset = 0);
+    void copyBufferToImage(const Staging& staging, VkImage image,
+                           uint32_t width, uint32_t height,
+                           uint32_t mipLevel = 0);
+
+    // The batch's command buffer, for recording barriers
+    VkCommandBuffer getCommandBuffer();
+
+    // The batch being recorded, which is complete once a later submit has
+    // made it through the queue
+    uint64_t getBatch() const { return nextBatch; }
+    bool isComplete(uint64_t batch);
+
+    // Submits what has been recorded without waiting for it
+    void submit();
+    // Submits and waits for every batch
+    void flush();
+
+   private:
+    struct Batch {
+        uint64_t id;
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+
+        // Position in the ring where the batch's staging data starts, kept
+        // increasing so that wrapping around needs no special cases
+        uint64_t begin;
+        uint32_t copies;
+
+        std::vector<std::pair<VkBuffer, VmaAllocation>> dedicated;
+    };
+
+    void begin();
+    void poll();
+    void waitOldest();
+    void retire(Batch& batch);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    VkBuffer ring = VK_NULL_HANDLE;
+    VmaAllocation ringAllocation = VK_NULL_HANDLE;
+    uint8_t* mapped = nullptr;
+    VkDeviceSize ringSize = 0;
+    VkDeviceSize alignment = 16;
+    uint64_t head = 0;
+
+    Batch current{};
+    bool recording = false;
+    std::deque<Batch> inFlight;
+    std::vector<Batch> spare;
+
+    uint64_t nextBatch = 1;
+    uint64_t completed = 0;
+};
+
+}  // namespace Ash
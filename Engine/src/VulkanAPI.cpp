@@ -5,9 +5,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <stb_image.h>
-
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <limits>
+#include <thread>
 
 #include "App.h"
 #include "Components.h"
@@ -15,39 +17,6 @@
 
 namespace Ash {
 
-VkCommandBuffer VulkanAPI::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    return commandBuffer;
-}
-
-void VulkanAPI::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
 VkResult CreateDebugUtilsMessengerEXT(
     VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
     const VkAllocationCallbacks* pAllocator,
@@ -298,15 +267,26 @@ void VulkanAPI::pickPhysicalDevice() {
     for (const auto& device : devices) {
         if (isDeviceSuitable(device)) {
             physicalDevice = device;
-            VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(device, &properties);
+            vkGetPhysicalDeviceProperties(device, &deviceProperties);
             ASH_INFO("Selecting {} as the physical device",
-                     properties.deviceName);
+                     deviceProperties.deviceName);
             break;
         }
     }
 
     ASH_ASSERT(physicalDevice != VK_NULL_HANDLE, "No suitable device found");
+
+    // Blitting between mip levels needs linear filtering of the texture
+    // format, mips are downsampled on the CPU otherwise
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(
+        physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+    VkFormatFeatureFlags blitFeatures =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    blitMipmaps = (formatProperties.optimalTilingFeatures & blitFeatures) ==
+                  blitFeatures;
+    if (!blitMipmaps) ASH_WARN("Generating mipmaps on the CPU");
 }
 
 void VulkanAPI::createInstance() {
@@ -392,11 +372,63 @@ void VulkanAPI::createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // Needed to sample KTX2 textures, which are never decompressed
+    textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionBC = textureCompressionBC;
+    if (!textureCompressionBC)
+        ASH_WARN("Device doesn't support BC textures, KTX2 files won't load");
+
+    if (indirectDrawing) {
+        // Instanced groups start at their own firstInstance, which indirect
+        // commands can only express with this feature
+        if (supportedFeatures.drawIndirectFirstInstance) {
+            deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+            deviceFeatures.multiDrawIndirect =
+                supportedFeatures.multiDrawIndirect;
+            multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        } else {
+            ASH_WARN(
+                "Device doesn't support drawIndirectFirstInstance, falling "
+                "back to direct drawing");
+            indirectDrawing = false;
+            cullingMode = CullingMode::None;
+        }
+    }
+
+    // The main vertex shader finds the quantisation of compressed vertices
+    // with gl_DrawIDARB
+    VkPhysicalDeviceVulkan11Features supportedFeatures11{};
+    supportedFeatures11.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedFeatures11;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+    VkPhysicalDeviceVulkan11Features deviceFeatures11{};
+    deviceFeatures11.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    deviceFeatures11.shaderDrawParameters =
+        supportedFeatures11.shaderDrawParameters;
+    drawParameters = supportedFeatures11.shaderDrawParameters;
+    if (!drawParameters) {
+        // A variant without draw parameters is used instead, which needs
+        // every draw's index pushed on its own
+        ASH_WARN(
+            "Device doesn't support shaderDrawParameters, drawing compressed "
+            "meshes one at a time");
+        if (vertexCompression) multiDrawIndirect = false;
+    }
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &deviceFeatures11;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount =
         static_cast<uint32_t>(queueCreateInfos.size());
@@ -572,7 +604,7 @@ void VulkanAPI::createDescriptorSetLayout() {
     ASH_INFO("Creating descriptor set layout");
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -584,7 +616,33 @@ void VulkanAPI::createDescriptorSetLayout() {
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 1> bindings = {uboLayoutBinding};
+    VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+    instanceLayoutBinding.binding = 1;
+    instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    instanceLayoutBinding.descriptorCount = 1;
+    instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding cameraLayoutBinding{};
+    cameraLayoutBinding.binding = 2;
+    cameraLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraLayoutBinding.descriptorCount = 1;
+    cameraLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding staticLayoutBinding{};
+    staticLayoutBinding.binding = 3;
+    staticLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    staticLayoutBinding.descriptorCount = 1;
+    staticLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding drawLayoutBinding{};
+    drawLayoutBinding.binding = 4;
+    drawLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    drawLayoutBinding.descriptorCount = 1;
+    drawLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings = {
+        uboLayoutBinding, instanceLayoutBinding, cameraLayoutBinding,
+        staticLayoutBinding, drawLayoutBinding};
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -595,7 +653,8 @@ void VulkanAPI::createDescriptorSetLayout() {
                                            &descriptorSetLayout) == VK_SUCCESS,
                "Failed to create descriptor set layout");
 
-    bindings[0] = samplerLayoutBinding;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplerLayoutBinding;
 
     ASH_ASSERT(
         vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
@@ -619,21 +678,32 @@ void VulkanAPI::createGraphicsPipelines(
 
     pipelineObjects = pipelines;
 
-    std::vector<char> vert =
-        Helper::readBinaryFile("assets/shaders/shader.vert.spv");
+    const char* vertPath = "assets/shaders/shader.vert.spv";
+    if (mainPushConstants)
+        vertPath = "assets/shaders/push.vert.spv";
+    else if (!drawParameters)
+        vertPath = "assets/shaders/shader.vert.nodrawparameters.spv";
+    std::vector<char> vert = Helper::readBinaryFile(vertPath);
     std::vector<char> frag =
         Helper::readBinaryFile("assets/shaders/shader.frag.spv");
 
     VkShaderModule vertShaderModule = createShaderModule(vert);
     VkShaderModule fragShaderModule = createShaderModule(frag);
 
+    // Tells vertex shaders which layout the attributes are in
+    VkBool32 compressedVertices = vertexCompression;
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specializationInfo{1, &specializationEntry,
+                                            sizeof(VkBool32),
+                                            &compressedVertices};
+
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType =
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = vertShaderModule;
     vertShaderStageInfo.pName = "main";
-    vertShaderStageInfo.pSpecializationInfo = nullptr;
+    vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType =
@@ -646,8 +716,12 @@ void VulkanAPI::createGraphicsPipelines(
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,
                                                       fragShaderStageInfo};
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescription();
+    auto bindingDescription = vertexCompression
+                                  ? CompressedVertex::getBindingDescription()
+                                  : Vertex::getBindingDescription();
+    auto attributeDescriptions =
+        vertexCompression ? CompressedVertex::getAttributeDescription()
+                          : Vertex::getAttributeDescription();
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType =
@@ -735,11 +809,21 @@ void VulkanAPI::createGraphicsPipelines(
 
     std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = {
         descriptorSetLayout, imageDescriptorSetLayout};
+
+    // The model is only read by pipelines drawing with push constants, the
+    // others ignore it
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawConstants);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount =
         static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     ASH_ASSERT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
                                       &pipelineLayout) == VK_SUCCESS,
@@ -770,6 +854,8 @@ void VulkanAPI::createGraphicsPipelines(
                    device, pipelineCache, 1, &pipelineInfo, nullptr,
                    &graphicsPipelines["main"]) == VK_SUCCESS,
                "Failed to create graphics pipeline");
+    pipelineIndices["main"] = 0;
+    if (mainPushConstants) pushConstantPipelines.insert("main");
 
     pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
     pipelineInfo.basePipelineHandle = graphicsPipelines["main"];
@@ -799,7 +885,8 @@ void VulkanAPI::createGraphicsPipelines(
 
             shaderStageInfo.module = shaderModules.back();
             shaderStageInfo.pName = "main";
-            shaderStageInfo.pSpecializationInfo = nullptr;
+            if (shaderStageInfo.stage == VK_SHADER_STAGE_VERTEX_BIT)
+                shaderStageInfo.pSpecializationInfo = &specializationInfo;
             shaderStageInfos.push_back(shaderStageInfo);
         }
 
@@ -810,6 +897,8 @@ void VulkanAPI::createGraphicsPipelines(
                        device, pipelineCache, 1, &pipelineInfo, nullptr,
                        &graphicsPipelines[pipeline.name]) == VK_SUCCESS,
                    "Failed to create user pipeline");
+        pipelineIndices[pipeline.name] = static_cast<uint32_t>(j + 1);
+        if (pipeline.pushConstants) pushConstantPipelines.insert(pipeline.name);
 
         for (auto& module : shaderModules)
             vkDestroyShaderModule(device, module, nullptr);
@@ -821,6 +910,65 @@ void VulkanAPI::createGraphicsPipelines(
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
 
+void VulkanAPI::createCullPipeline() {
+    ASH_INFO("Creating culling pipeline");
+
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    ASH_ASSERT(
+        vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
+                                    &cullDescriptorSetLayout) == VK_SUCCESS,
+        "Failed to create culling descriptor set layout");
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    ASH_ASSERT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
+                                      &cullPipelineLayout) == VK_SUCCESS,
+               "Failed to create culling pipeline layout");
+
+    std::vector<char> comp =
+        Helper::readBinaryFile("assets/shaders/cull.comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(comp);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+
+    ASH_ASSERT(vkCreateComputePipelines(device, pipelineCache, 1,
+                                        &pipelineInfo, nullptr,
+                                        &cullPipeline) == VK_SUCCESS,
+               "Failed to create culling pipeline");
+
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+
 void VulkanAPI::createFramebuffers() {
     ASH_INFO("Creating framebuffers");
 
@@ -846,174 +994,211 @@ void VulkanAPI::createFramebuffers() {
     }
 }
 
-size_t calculateDynamicAllignment(size_t minUniformBufferAllignment,
-                                  size_t dynamicAllignment) {
-    if (minUniformBufferAllignment > 0)
-        dynamicAllignment =
-            (dynamicAllignment + minUniformBufferAllignment - 1) &
-            ~(minUniformBufferAllignment - 1);
-    return dynamicAllignment;
-}
-
 void VulkanAPI::createUniformBuffers() {
     ASH_INFO("Creating uniform buffers");
 
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-
-    size_t minUniformBufferAllignment =
-        properties.limits.minUniformBufferOffsetAlignment;
-    size_t dynamicAllignment = sizeof(UniformBufferObject);
-
-    dynamicAllignment = calculateDynamicAllignment(minUniformBufferAllignment,
-                                                   dynamicAllignment);
-
-    VkDeviceSize bufferSize = dynamicAllignment * MAX_INSTANCES;
+    // The camera is shared by every draw of a frame
+    for (FrameData& frame : frames) {
+        createBuffer(sizeof(CameraData), VMA_MEMORY_USAGE_CPU_TO_GPU,
+                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, frame.cameraBuffer,
+                     frame.cameraAllocation, (void**)&frame.cameraData);
+    }
 
-    uniformBuffers.resize(swapchainImages.size());
+    createObjectRing();
+    createStaticObjects();
+}
 
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
-        createBuffer(bufferSize, VMA_MEMORY_USAGE_CPU_TO_GPU,
-                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                     uniformBuffers[i].uniformBuffer,
-                     uniformBuffers[i].uniformBufferAllocation);
-    }
+void VulkanAPI::createObjectRing() {
+    // Instanced draws index the per-object data with gl_InstanceIndex, so it
+    // is tightly packed in a storage buffer. Every frame in flight gets a
+    // region of the ring, bound with a dynamic offset
+    VkDeviceSize alignment =
+        deviceProperties.limits.minStorageBufferOffsetAlignment;
+    VkDeviceSize regionSize = sizeof(ObjectData) * instanceCapacity;
+    regionSize = (regionSize + alignment - 1) & ~(alignment - 1);
+
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    void* mapped;
+    createBuffer(regionSize * MAX_FRAMES_IN_FLIGHT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer, allocation,
+                 &mapped);
+
+    objectRing.init(allocator, buffer, allocation, mapped, regionSize);
 }
 
 void VulkanAPI::createDescriptorPool(uint32_t maxSets) {
     ASH_INFO("Creating descriptor pool");
 
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    // Every frame has an object set with five buffers and a culling set with
+    // six, both read the object ring through a dynamic offset
+    std::array<VkDescriptorPoolSize, 4> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     poolSizes[0].descriptorCount =
-        static_cast<uint32_t>(swapchainImages.size() * maxSets);
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 8);
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     poolSizes[1].descriptorCount =
-        static_cast<uint32_t>(swapchainImages.size());
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[3].descriptorCount = maxSets;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(swapchainImages.size() * maxSets);
+    poolInfo.maxSets =
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2) + maxSets;
 
     ASH_ASSERT(vkCreateDescriptorPool(device, &poolInfo, nullptr,
                                       &descriptorPool) == VK_SUCCESS,
                "Failed to create descriptor pool");
 }
 
-void VulkanAPI::createDescriptorSets(std::vector<VkDescriptorSet>& sets,
-                                     const Texture& texture) {
-    ASH_INFO("Creating descriptor sets");
-
-    std::vector<VkDescriptorSetLayout> layouts(swapchainImages.size(),
-                                               descriptorSetLayout);
+void VulkanAPI::createTextureDescriptorSet(Texture& texture) {
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount =
-        static_cast<uint32_t>(swapchainImages.size());
-    allocInfo.pSetLayouts = layouts.data();
-
-    sets.resize(swapchainImages.size());
-    ASH_ASSERT(
-        vkAllocateDescriptorSets(device, &allocInfo, sets.data()) == VK_SUCCESS,
-        "Failed to allocate descriptor sets");
-
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = texture.imageView;
-        imageInfo.sampler = textureSampler;
-
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = sets[i];
-        descriptorWrites[0].dstBinding = 1;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType =
-            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(device,
-                               static_cast<uint32_t>(descriptorWrites.size()),
-                               descriptorWrites.data(), 0, nullptr);
-    }
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &imageDescriptorSetLayout;
+
+    ASH_ASSERT(vkAllocateDescriptorSets(device, &allocInfo,
+                                        &texture.descriptorSet) == VK_SUCCESS,
+               "Failed to allocate texture descriptor set");
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = texture.imageView;
+    imageInfo.sampler = textureSampler;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = texture.descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
 }
 
 void VulkanAPI::createDescriptorSets() {
     ASH_INFO("Creating descriptor sets");
 
     if (uboDescriptorSets.size() == 0) {
-        std::vector<VkDescriptorSetLayout> layouts(swapchainImages.size(),
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT,
                                                    descriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
         allocInfo.descriptorSetCount =
-            static_cast<uint32_t>(swapchainImages.size());
+            static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
         allocInfo.pSetLayouts = layouts.data();
 
-        uboDescriptorSets.resize(swapchainImages.size());
+        uboDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
         ASH_ASSERT(
             vkAllocateDescriptorSets(device, &allocInfo,
                                      uboDescriptorSets.data()) == VK_SUCCESS,
             "Failed to allocate descriptor sets");
     }
 
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) writeDescriptorSets(i);
+}
 
-    size_t minUniformBufferAllignment =
-        properties.limits.minUniformBufferOffsetAlignment;
-    size_t dynamicAllignment = sizeof(UniformBufferObject);
+void VulkanAPI::writeDescriptorSets(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+    frame.staticObjectBuffer = staticObjectBuffer;
+
+    std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+    bufferInfos[0].buffer = objectRing.getBuffer();
+    bufferInfos[0].offset = 0;
+    bufferInfos[0].range = objectRing.getRegionSize();
+    bufferInfos[1].buffer = frame.instanceBuffer;
+    bufferInfos[1].offset = 0;
+    bufferInfos[1].range = VK_WHOLE_SIZE;
+    bufferInfos[2].buffer = frame.cameraBuffer;
+    bufferInfos[2].offset = 0;
+    bufferInfos[2].range = sizeof(CameraData);
+    bufferInfos[3].buffer = staticObjectBuffer;
+    bufferInfos[3].offset = 0;
+    bufferInfos[3].range = VK_WHOLE_SIZE;
+    bufferInfos[4].buffer = frame.drawDataBuffer;
+    bufferInfos[4].offset = 0;
+    bufferInfos[4].range = VK_WHOLE_SIZE;
+
+    std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+    for (uint32_t j = 0; j < descriptorWrites.size(); j++) {
+        descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[j].dstSet = uboDescriptorSets[frameIndex];
+        descriptorWrites[j].dstBinding = j;
+        descriptorWrites[j].dstArrayElement = 0;
+        descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[j].descriptorCount = 1;
+        descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+    }
+    descriptorWrites[0].descriptorType =
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
-    dynamicAllignment = calculateDynamicAllignment(minUniformBufferAllignment,
-                                                   dynamicAllignment);
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
+}
 
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i].uniformBuffer;
-        bufferInfo.offset = 0;
-        bufferInfo.range = dynamicAllignment;
-
-        //        VkDescriptorImageInfo imageInfo{};
-        //        imageInfo.imageLayout =
-        //        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; imageInfo.imageView
-        //        = texture.imageView; imageInfo.sampler = textureSampler;
-
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = uboDescriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType =
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-        //        descriptorWrites[1].sType =
-        //        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        //        descriptorWrites[1].dstSet = descriptorSets[i];
-        //        descriptorWrites[1].dstBinding = 1;
-        //        descriptorWrites[1].dstArrayElement = 0;
-        //        descriptorWrites[1].descriptorType =
-        //            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        //        descriptorWrites[1].descriptorCount = 1;
-        //        descriptorWrites[1].pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(device,
-                               static_cast<uint32_t>(descriptorWrites.size()),
-                               descriptorWrites.data(), 0, nullptr);
+void VulkanAPI::createCullDescriptorSets() {
+    ASH_INFO("Creating culling descriptor sets");
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        FrameData& frame = frames[i];
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &cullDescriptorSetLayout;
+
+        ASH_ASSERT(vkAllocateDescriptorSets(device, &allocInfo,
+                                            &frame.cullDescriptorSet) ==
+                       VK_SUCCESS,
+                   "Failed to allocate culling descriptor set");
+
+        writeCullDescriptorSet(i);
     }
 }
 
+void VulkanAPI::writeCullDescriptorSet(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+
+    std::array<VkBuffer, 6> buffers = {
+        objectRing.getBuffer(),      frame.cullBuffer,     frame.drawRefBuffer,
+        frame.culledIndirectBuffer, frame.instanceBuffer, staticObjectBuffer};
+
+    std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+    std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+    for (uint32_t j = 0; j < descriptorWrites.size(); j++) {
+        bufferInfos[j].buffer = buffers[j];
+        bufferInfos[j].offset = 0;
+        bufferInfos[j].range = VK_WHOLE_SIZE;
+
+        descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[j].dstSet = frame.cullDescriptorSet;
+        descriptorWrites[j].dstBinding = j;
+        descriptorWrites[j].dstArrayElement = 0;
+        descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[j].descriptorCount = 1;
+        descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+    }
+    bufferInfos[0].range = objectRing.getRegionSize();
+    descriptorWrites[0].descriptorType =
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
+}
+
 void VulkanAPI::createCommandPools() {
     ASH_INFO("Creating command pool");
     QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
@@ -1021,17 +1206,37 @@ void VulkanAPI::createCommandPools() {
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    poolInfo.flags = 0;
-
-    ASH_ASSERT(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) ==
-                   VK_SUCCESS,
-               "Failed to create command pool");
 
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    // Copies and layout transitions are recorded here and submitted with the
+    // next frame
+    VkDeviceSize copyAlignment = std::max<VkDeviceSize>(
+        16, deviceProperties.limits.optimalBufferCopyOffsetAlignment);
+    uploads.init(device, allocator, graphicsQueue,
+                 queueFamilyIndices.graphicsFamily.value(), STAGING_SIZE,
+                 copyAlignment);
+
+    // Each frame in flight owns its pools so that they can be reset as soon as
+    // that frame's fence signals, without waiting on the whole queue
+    frames.resize(MAX_FRAMES_IN_FLIGHT);
+    for (FrameData& frame : frames) {
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        ASH_ASSERT(vkCreateCommandPool(device, &poolInfo, nullptr,
+                                       &frame.commandPool) == VK_SUCCESS,
+                   "Failed to create frame command pool");
+
+        // Command pools are externally synchronized, so every recording
+        // thread gets a pool of its own
+        poolInfo.flags = 0;
+        frame.drawCommandPools.resize(recordingThreads);
+        for (VkCommandPool& pool : frame.drawCommandPools) {
+            ASH_ASSERT(vkCreateCommandPool(device, &poolInfo, nullptr,
+                                           &pool) == VK_SUCCESS,
+                       "Failed to create frame draw command pool");
+        }
+    }
 
-    ASH_ASSERT(vkCreateCommandPool(device, &poolInfo, nullptr,
-                                   &transferCommandPool) == VK_SUCCESS,
-               "Failed to create command pool");
+    // One part per pool, the first recorded by the render thread itself
+    recordingPool.start(recordingThreads - 1);
 }
 
 uint32_t VulkanAPI::findMemoryType(uint32_t typeFilter,
@@ -1053,132 +1258,851 @@ uint32_t VulkanAPI::findMemoryType(uint32_t typeFilter,
 void VulkanAPI::createCommandBuffers() {
     ASH_INFO("Creating command buffers");
 
-    commandBuffers.resize(swapchainFramebuffers.size());
+    for (FrameData& frame : frames) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        ASH_ASSERT(vkAllocateCommandBuffers(device, &allocInfo,
+                                            &frame.commandBuffer) == VK_SUCCESS,
+                   "Failed to allocate command buffers");
+
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        ASH_ASSERT(vkAllocateCommandBuffers(device, &allocInfo,
+                                            &frame.pushCommands) == VK_SUCCESS,
+                   "Failed to allocate push constant command buffers");
+
+        frame.drawCommands.resize(frame.drawCommandPools.size());
+        for (size_t i = 0; i < frame.drawCommandPools.size(); i++) {
+            allocInfo.commandPool = frame.drawCommandPools[i];
+            ASH_ASSERT(vkAllocateCommandBuffers(device, &allocInfo,
+                                                &frame.drawCommands[i]) ==
+                           VK_SUCCESS,
+                       "Failed to allocate draw command buffers");
+        }
+    }
+}
+
+void VulkanAPI::createDrawBuffers(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+    frame.instanceCapacity = instanceCapacity;
+    frame.drawCapacity = drawCapacity;
+
+    VkDeviceSize commandsSize =
+        sizeof(VkDrawIndexedIndirectCommand) * drawCapacity;
+
+    // Buffers written by the host stay mapped for the renderer's lifetime.
+    // Host visible since it's written by the host unless culling is on
+    createBuffer(sizeof(uint32_t) * instanceCapacity,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.instanceBuffer,
+                 frame.instanceAllocation, (void**)&frame.instanceData);
+    createBuffer(sizeof(DrawData) * drawCapacity, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.drawDataBuffer,
+                 frame.drawDataAllocation, (void**)&frame.drawData);
+
+    if (!indirectDrawing) return;
+
+    createBuffer(commandsSize, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 frame.indirectBuffer, frame.indirectAllocation,
+                 (void**)&frame.indirectData);
+
+    if (cullingMode != CullingMode::Gpu) return;
+
+    createBuffer(commandsSize, VMA_MEMORY_USAGE_GPU_ONLY,
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 frame.culledIndirectBuffer, frame.culledIndirectAllocation);
+    createBuffer(sizeof(CullInstance) * instanceCapacity,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.cullBuffer,
+                 frame.cullAllocation, &frame.cullData);
+    // Every draw belongs to exactly one group
+    createBuffer(sizeof(uint32_t) * drawCapacity, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.drawRefBuffer,
+                 frame.drawRefAllocation, &frame.drawRefData);
+}
 
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+void VulkanAPI::destroyDrawBuffers(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
 
-    ASH_ASSERT(vkAllocateCommandBuffers(device, &allocInfo,
-                                        commandBuffers.data()) == VK_SUCCESS,
-               "Failed to allocate command buffers");
+    vmaDestroyBuffer(allocator, frame.instanceBuffer, frame.instanceAllocation);
+    vmaDestroyBuffer(allocator, frame.drawDataBuffer, frame.drawDataAllocation);
 
-    recordCommandBuffers();
+    if (frame.indirectBuffer != VK_NULL_HANDLE)
+        vmaDestroyBuffer(allocator, frame.indirectBuffer,
+                         frame.indirectAllocation);
+
+    if (frame.culledIndirectBuffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(allocator, frame.culledIndirectBuffer,
+                         frame.culledIndirectAllocation);
+        vmaDestroyBuffer(allocator, frame.cullBuffer, frame.cullAllocation);
+        vmaDestroyBuffer(allocator, frame.drawRefBuffer,
+                         frame.drawRefAllocation);
+    }
 }
 
-void VulkanAPI::recordCommandBuffers() {
-    for (size_t i = 0; i < commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0;
-        beginInfo.pInheritanceInfo = nullptr;
+void VulkanAPI::reserveInstances(size_t frameIndex) {
+    uint32_t instanceCount =
+        static_cast<uint32_t>(renderQueue.getInstances().size());
+    uint32_t drawCount = static_cast<uint32_t>(renderQueue.getDraws().size());
 
-        ASH_ASSERT(
-            vkBeginCommandBuffer(commandBuffers[i], &beginInfo) == VK_SUCCESS,
-            "Failed to begin command buffer {}", i);
-
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapchainFramebuffers[i];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapchainExtent;
-
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {
-            {clearColor.r, clearColor.g, clearColor.b, clearColor.a}};
-        clearValues[1].depthStencil = {1.0f, 0};
-
-        renderPassInfo.clearValueCount =
-            static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
-
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
-                             VK_SUBPASS_CONTENTS_INLINE);
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapchainExtent.width;
-        viewport.height = (float)swapchainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapchainExtent;
-
-        vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-        vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-
-        VkDeviceSize offsets[] = {0};
-
-        std::shared_ptr<Scene> scene = Renderer::getScene();
-        if (scene) {
-            auto renderables = scene->registry.view<Renderable>();
-
-            uint32_t h = 0;
-            for (auto entity : renderables) {
-                auto& renderable = renderables.get(entity);
-
-                Model& model = Renderer::getModel(renderable.model);
-                for (uint32_t j = 0; j < model.meshes.size(); j++) {
-                    Mesh& mesh = Renderer::getMesh(model.meshes[j]);
-                    VkBuffer vb[] = {mesh.ivb.buffer};
-
-                    // Each model should have their own pipeline
-                    vkCmdBindPipeline(commandBuffers[i],
-                                      VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                      graphicsPipelines[renderable.pipeline]);
-
-                    // Each model has their own mesh and thus their own vertex
-                    // and index buffers
-                    vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vb,
-                                           offsets);
-
-                    vkCmdBindIndexBuffer(commandBuffers[i], mesh.ivb.buffer,
-                                         mesh.ivb.vertSize,
-                                         VK_INDEX_TYPE_UINT32);
-
-                    VkPhysicalDeviceProperties properties;
-                    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-
-                    size_t minUniformBufferAllignment =
-                        properties.limits.minUniformBufferOffsetAlignment;
-                    size_t dynamicAllignment = sizeof(UniformBufferObject);
-
-                    dynamicAllignment = calculateDynamicAllignment(
-                        minUniformBufferAllignment, dynamicAllignment);
-
-                    uint32_t dynamicOffset =
-                        h * static_cast<uint32_t>(dynamicAllignment);
-
-                    // Each entity has their own transform and thus their
-                    // own UBO transform matrix
-                    vkCmdBindDescriptorSets(commandBuffers[i],
-                                            VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                            pipelineLayout, 0, 1,
-                                            &uboDescriptorSets[i], 0, nullptr);
-
-                    vkCmdBindDescriptorSets(
-                        commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        pipelineLayout, 0, 1, &renderable.descriptorSets[j][i],
-                        1, &dynamicOffset);
-
-                    vkCmdDrawIndexed(commandBuffers[i], mesh.ivb.numIndices, 1,
-                                     0, 0, 0);
-                }
-                h++;
+    // Doubling keeps reallocations rare as a scene grows
+    if (instanceCount > instanceCapacity) {
+        while (instanceCapacity < instanceCount) instanceCapacity *= 2;
+        ASH_INFO("Growing instance capacity to {}", instanceCapacity);
+
+        // The other frames in flight may still be reading the old ring
+        retireBuffer(objectRing.getBuffer(), objectRing.getAllocation());
+        createObjectRing();
+        objectListVersion++;
+    }
+
+    if (drawCount > drawCapacity) {
+        while (drawCapacity < drawCount) drawCapacity *= 2;
+        ASH_INFO("Growing draw capacity to {}", drawCapacity);
+    }
+
+    stats.instanceCapacity = instanceCapacity;
+    stats.drawCapacity = drawCapacity;
+
+    FrameData& frame = frames[frameIndex];
+    bool grown = frame.instanceCapacity != instanceCapacity ||
+                 frame.drawCapacity != drawCapacity;
+    if (!grown && frame.staticObjectBuffer == staticObjectBuffer) return;
+
+    // The frame's fence has been waited on, so nothing reads its buffers
+    if (grown) {
+        destroyDrawBuffers(frameIndex);
+        createDrawBuffers(frameIndex);
+        frame.drawListVersion = 0;
+    }
+    writeDescriptorSets(frameIndex);
+    if (cullingMode == CullingMode::Gpu) writeCullDescriptorSet(frameIndex);
+
+    // Updating the descriptor sets invalidated the recorded draws
+    frame.batchListVersion = 0;
+}
+
+void VulkanAPI::retireBuffer(VkBuffer buffer, VmaAllocation allocation) {
+    retiredBuffers.push_back({buffer, allocation, frameNumber});
+}
+
+void VulkanAPI::destroyRetiredBuffers() {
+    // Every frame submitted before a buffer was retired has completed once
+    // the fences of all frames in flight have been waited on since
+    auto end = std::remove_if(
+        retiredBuffers.begin(), retiredBuffers.end(),
+        [&](const RetiredBuffer& retired) {
+            if (retired.frameNumber + MAX_FRAMES_IN_FLIGHT > frameNumber)
+                return false;
+
+            vmaDestroyBuffer(allocator, retired.buffer, retired.allocation);
+            return true;
+        });
+    retiredBuffers.erase(end, retiredBuffers.end());
+
+    auto geometryEnd = std::remove_if(
+        retiredGeometry.begin(), retiredGeometry.end(),
+        [&](const RetiredGeometry& retired) {
+            if (retired.frameNumber + MAX_FRAMES_IN_FLIGHT > frameNumber)
+                return false;
+
+            vertexGeometry.arena.free(retired.ivb.vertices);
+            indexGeometry.arena.free(retired.ivb.indices);
+            return true;
+        });
+    retiredGeometry.erase(geometryEnd, retiredGeometry.end());
+}
+
+void VulkanAPI::writeIndirectCommands(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+
+    VkDrawIndexedIndirectCommand* commands = frame.indirectData;
+
+    const std::vector<DrawCall>& draws = renderQueue.getDraws();
+    for (size_t i = 0; i < draws.size(); i++) {
+        commands[i].indexCount = draws[i].indexCount;
+        // Culling counts the visible instances itself
+        commands[i].instanceCount =
+            cullingMode == CullingMode::None ? draws[i].instanceCount : 0;
+        commands[i].firstIndex = draws[i].firstIndex;
+        commands[i].vertexOffset = draws[i].vertexOffset;
+        commands[i].firstInstance = draws[i].firstInstance;
+    }
+
+    vmaFlushAllocation(allocator, frame.indirectAllocation, 0, VK_WHOLE_SIZE);
+}
+
+void VulkanAPI::writeInstanceIndices(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+
+    // Groups are laid out contiguously, so every instance draws its own object
+    uint32_t count = static_cast<uint32_t>(renderQueue.getInstances().size());
+    std::copy_n(objectIndices.begin(), count, frame.instanceData);
+
+    vmaFlushAllocation(allocator, frame.instanceAllocation, 0, VK_WHOLE_SIZE);
+}
+
+void VulkanAPI::writeDrawData(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+
+    const std::vector<DrawCall>& draws = renderQueue.getDraws();
+    for (size_t i = 0; i < draws.size(); i++) {
+        frame.drawData[i] = {glm::vec4(draws[i].positionScale, 0.0f),
+                             glm::vec4(draws[i].positionOffset, 0.0f)};
+    }
+
+    vmaFlushAllocation(allocator, frame.drawDataAllocation, 0, VK_WHOLE_SIZE);
+}
+
+void VulkanAPI::writeCullData(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+
+    std::memcpy(frame.cullData, cullInstances.data(),
+                sizeof(CullInstance) * cullInstances.size());
+    vmaFlushAllocation(allocator, frame.cullAllocation, 0, VK_WHOLE_SIZE);
+
+    std::memcpy(frame.drawRefData, cullDrawRefs.data(),
+                sizeof(uint32_t) * cullDrawRefs.size());
+    vmaFlushAllocation(allocator, frame.drawRefAllocation, 0, VK_WHOLE_SIZE);
+}
+
+void VulkanAPI::writeVisibleInstances(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+
+    visibleInstances.clear();
+    culler.cull(Frustum(viewProjection), visibleInstances);
+
+    // Visible instances are compacted to the front of their group's range
+    visibleCounts.assign(culler.size(), 0);
+
+    for (uint32_t instance : visibleInstances) {
+        uint32_t firstInstance = cullInstances[instance].firstInstance;
+        frame.instanceData[firstInstance + visibleCounts[firstInstance]++] =
+            objectIndices[instance];
+    }
+    vmaFlushAllocation(allocator, frame.instanceAllocation, 0, VK_WHOLE_SIZE);
+
+    const std::vector<DrawCall>& draws = renderQueue.getDraws();
+    for (size_t i = 0; i < draws.size(); i++) {
+        frame.indirectData[i].instanceCount =
+            visibleCounts[draws[i].firstInstance];
+    }
+    vmaFlushAllocation(allocator, frame.indirectAllocation, 0, VK_WHOLE_SIZE);
+
+    stats.visibleInstances = static_cast<uint32_t>(visibleInstances.size());
+}
+
+void VulkanAPI::recordCulling(VkCommandBuffer commandBuffer) {
+    FrameData& frame = frames[currentFrame];
+
+    uint32_t instanceCount = static_cast<uint32_t>(cullInstances.size());
+    size_t drawCount = renderQueue.getDraws().size();
+    if (instanceCount == 0 || drawCount == 0) return;
+
+    // Reset the instance counts from the template written by the host
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(VkDrawIndexedIndirectCommand) * drawCount;
+    vkCmdCopyBuffer(commandBuffer, frame.indirectBuffer,
+                    frame.culledIndirectBuffer, 1, &copyRegion);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                         0, nullptr, 0, nullptr);
+
+    Frustum frustum(viewProjection);
+
+    CullConstants constants{};
+    std::copy(frustum.planes.begin(), frustum.planes.end(), constants.planes);
+    constants.instanceCount = instanceCount;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            cullPipelineLayout, 0, 1, &frame.cullDescriptorSet,
+                            1, &frame.objectOffset);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDispatch(commandBuffer,
+                  (instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1,
+                  1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanAPI::recordCommandBuffer(uint32_t imageIndex) {
+    FrameData& frame = frames[currentFrame];
+
+    // Only safe because this frame's fence has already been waited on
+    vkResetCommandPool(device, frame.commandPool, 0);
+
+    // The object offset is baked into the draw commands
+    bool recordDraws = frame.recordedObjectOffset != frame.objectOffset;
+
+    if (frame.drawListVersion != drawListVersion) {
+        frame.drawListVersion = drawListVersion;
+
+        // Indirect draws read their counts from the buffer, so as long as the
+        // batches haven't moved the recorded commands are still valid
+        if (indirectDrawing) writeIndirectCommands(currentFrame);
+        if (vertexCompression) writeDrawData(currentFrame);
+        if (cullingMode == CullingMode::Gpu) writeCullData(currentFrame);
+        if (cullingMode == CullingMode::None)
+            writeInstanceIndices(currentFrame);
+        if (!indirectDrawing || frame.batchListVersion != batchListVersion)
+            recordDraws = true;
+    }
+
+    if (recordDraws) recordDrawCommands(currentFrame);
+    if (pushConstantInstances > 0) recordPushConstantDraws(currentFrame);
+
+    // Visibility changes every frame but only the buffers depend on it
+    if (cullingMode == CullingMode::Cpu) writeVisibleInstances(currentFrame);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+
+    ASH_ASSERT(
+        vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) == VK_SUCCESS,
+        "Failed to begin command buffer {}", currentFrame);
+
+    if (cullingMode == CullingMode::Gpu) recordCulling(frame.commandBuffer);
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = swapchainFramebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = swapchainExtent;
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {
+        {clearColor.r, clearColor.g, clearColor.b, clearColor.a}};
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    vkCmdExecuteCommands(frame.commandBuffer, frame.activeDrawCommands,
+                         frame.drawCommands.data());
+    if (pushConstantInstances > 0)
+        vkCmdExecuteCommands(frame.commandBuffer, 1, &frame.pushCommands);
+
+    vkCmdEndRenderPass(frame.commandBuffer);
+
+    ASH_ASSERT(vkEndCommandBuffer(frame.commandBuffer) == VK_SUCCESS,
+               "Failed to record command buffer {}", currentFrame);
+}
+
+void VulkanAPI::buildRenderQueue() {
+    renderQueue.clear();
+    renderQueueVersion = drawListVersion;
+    cullGroups.clear();
+    pushConstantInstances = 0;
+    pushObjects.clear();
+
+    std::shared_ptr<Scene> scene = Renderer::getScene();
+    if (!scene) {
+        objectIndices.clear();
+        dynamicInstances.clear();
+        if (renderQueue.batch()) batchListVersion++;
+        if (cullingMode != CullingMode::None) buildCullData();
+        return;
+    }
+
+    // Entities sharing a model and pipeline are drawn as one instanced draw
+    // per mesh
+    std::map<std::pair<std::string, std::string>, std::vector<entt::entity>>
+        groups;
+
+    auto renderables = scene->registry.view<Renderable>();
+    for (auto entity : renderables) {
+        auto& renderable = renderables.get(entity);
+        groups[{renderable.model, renderable.pipeline}].push_back(entity);
+    }
+
+    // Resolve everything up front so the recording threads never touch the
+    // registry or the renderer's resource maps
+    for (auto& [group, entities] : groups) {
+        auto& [modelName, pipelineName] = group;
+
+        auto pipeline = pipelineIndices.find(pipelineName);
+        ASH_ASSERT(pipeline != pipelineIndices.end(), "Unknown pipeline {}",
+                   pipelineName);
+
+        uint32_t firstInstance =
+            static_cast<uint32_t>(renderQueue.getInstances().size());
+        for (auto entity : entities) renderQueue.addInstance(entity);
+
+        Model& model = Renderer::getModel(modelName);
+
+        bool pushConstants = pushConstantPipelines.count(pipelineName) > 0;
+        if (pushConstants) {
+            pushConstantInstances += static_cast<uint32_t>(entities.size());
+            for (uint32_t i = 0; i < entities.size(); i++)
+                pushObjects[entities[i]] = firstInstance + i;
+        }
+
+        // Culled as a whole, using a sphere around all of the model's meshes
+        glm::vec3 min(std::numeric_limits<float>::max());
+        glm::vec3 max(std::numeric_limits<float>::lowest());
+        for (const std::string& meshName : model.meshes) {
+            const Bounds& bounds = Renderer::getMesh(meshName).bounds;
+            min = glm::min(min, bounds.center - bounds.radius);
+            max = glm::max(max, bounds.center + bounds.radius);
+        }
+
+        CullGroup cullGroup{};
+        cullGroup.sphere = glm::vec4((min + max) * 0.5f,
+                                     glm::length(max - min) * 0.5f);
+        cullGroup.firstInstance = firstInstance;
+        cullGroup.instanceCount = static_cast<uint32_t>(entities.size());
+        cullGroups.push_back(cullGroup);
+        for (uint32_t j = 0; j < model.meshes.size(); j++) {
+            Mesh& mesh = Renderer::getMesh(model.meshes[j]);
+            Texture& texture = Renderer::getTexture(model.textures[j]);
+
+            DrawCall draw{};
+            draw.key =
+                RenderQueue::makeKey(pipeline->second, texture.id, mesh.id);
+            draw.pipeline = graphicsPipelines[pipelineName];
+            draw.textureSet = texture.descriptorSet;
+            draw.pushConstants = pushConstants;
+            draw.indexCount = mesh.ivb.numIndices;
+            draw.firstIndex = static_cast<uint32_t>(
+                indexGeometry.arena.getOffset(mesh.ivb.indices) /
+                sizeof(uint32_t));
+            draw.vertexOffset = static_cast<int32_t>(
+                vertexGeometry.arena.getOffset(mesh.ivb.vertices) /
+                vertexStride);
+            draw.positionScale = mesh.ivb.positionScale;
+            draw.positionOffset = mesh.ivb.positionOffset;
+            draw.firstInstance = firstInstance;
+            draw.instanceCount = static_cast<uint32_t>(entities.size());
+            renderQueue.push(draw);
+        }
+    }
+
+    renderQueue.sort();
+    if (renderQueue.batch()) batchListVersion++;
+
+    if (cullingMode != CullingMode::None) buildCullData();
+    classifyInstances(scene->registry);
+}
+
+void VulkanAPI::classifyInstances(entt::registry& registry) {
+    const std::vector<entt::entity>& instances = renderQueue.getInstances();
+
+    // Dynamic objects are packed in draw order so the ring is written
+    // linearly, static ones are indexed with the flag set
+    std::vector<entt::entity> statics;
+    objectIndices.resize(instances.size());
+    dynamicInstances.clear();
+    dynamicObjects.clear();
+    for (uint32_t i = 0; i < instances.size(); i++) {
+        // Their matrices are pushed, so the index is never read
+        if (pushObjects.count(instances[i])) {
+            objectIndices[i] = 0;
+        } else if (registry.has<Static>(instances[i])) {
+            objectIndices[i] =
+                static_cast<uint32_t>(statics.size()) | STATIC_OBJECT;
+            statics.push_back(instances[i]);
+        } else {
+            objectIndices[i] = static_cast<uint32_t>(dynamicInstances.size());
+            dynamicInstances.push_back(i);
+            dynamicObjects[instances[i]] = i;
+        }
+    }
+
+    // Every frame rewrites its dynamic objects in full on its next turn
+    objectListVersion++;
+    changedEntities.clear();
+
+    if (statics != staticEntities) {
+        staticEntities = std::move(statics);
+
+        // Frames in flight may still read the old buffer, every frame's
+        // descriptor sets are pointed at the new one in reserveInstances
+        retireBuffer(staticObjectBuffer, staticObjectAllocation);
+        createStaticObjects();
+    }
+
+    instanceModels.resize(pushConstantInstances > 0 ? instances.size() : 0);
+    for (auto [entity, i] : pushObjects) {
+        WorldTransform* transform = registry.try_get<WorldTransform>(entity);
+        instanceModels[i] = transform ? transform->matrix : glm::mat4(1.0f);
+    }
+
+    // Cull spheres are placed for every instance here and afterwards only for
+    // the ones that move
+    for (uint32_t i = 0; i < instances.size(); i++) {
+        if (cullingMode != CullingMode::None)
+            cullInstances[i].objectIndex = objectIndices[i];
+
+        if (cullingMode == CullingMode::Cpu) {
+            WorldTransform* transform =
+                registry.try_get<WorldTransform>(instances[i]);
+            setCullSphere(i, transform ? transform->matrix : glm::mat4(1.0f));
+        }
+    }
+}
+
+void VulkanAPI::createStaticObjects() {
+    // Never empty so the descriptor sets always have something to point at
+    size_t count = std::max<size_t>(staticEntities.size(), 1);
+    VkDeviceSize size = sizeof(ObjectData) * count;
+
+    createBuffer(size, VMA_MEMORY_USAGE_GPU_ONLY,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 staticObjectBuffer, staticObjectAllocation);
+
+    std::shared_ptr<Scene> scene = Renderer::getScene();
+    if (staticEntities.empty() || !scene) return;
+
+    UploadContext::Staging staging = uploads.stage(size);
+
+    ObjectData* objects = static_cast<ObjectData*>(staging.data);
+    for (size_t i = 0; i < staticEntities.size(); i++) {
+        WorldTransform* transform =
+            scene->registry.try_get<WorldTransform>(staticEntities[i]);
+        objects[i].model = transform ? transform->matrix : glm::mat4(1.0f);
+    }
+
+    // Lands before the frame that first reads it
+    uploads.copyBuffer(staging, staticObjectBuffer, size);
+
+    ASH_INFO("Uploaded {} static objects", staticEntities.size());
+}
+
+void VulkanAPI::setCullSphere(uint32_t instance, const glm::mat4& model) {
+    const glm::vec4& sphere = cullInstances[instance].sphere;
+    glm::vec3 center(model * glm::vec4(glm::vec3(sphere), 1.0f));
+    float scale = glm::max(glm::max(glm::length(glm::vec3(model[0])),
+                                    glm::length(glm::vec3(model[1]))),
+                           glm::length(glm::vec3(model[2])));
+    culler.set(instance, center, sphere.w * scale);
+}
+
+void VulkanAPI::buildCullData() {
+    const std::vector<DrawCall>& draws = renderQueue.getDraws();
+    size_t instanceCount = renderQueue.getInstances().size();
+
+    std::vector<uint32_t> instanceGroups(instanceCount);
+    for (uint32_t g = 0; g < cullGroups.size(); g++) {
+        for (uint32_t i = 0; i < cullGroups[g].instanceCount; i++)
+            instanceGroups[cullGroups[g].firstInstance + i] = g;
+    }
+
+    // Sorting scattered the draws of each group
+    std::vector<std::vector<uint32_t>> groupDraws(cullGroups.size());
+    for (uint32_t i = 0; i < draws.size(); i++)
+        groupDraws[instanceGroups[draws[i].firstInstance]].push_back(i);
+
+    cullDrawRefs.clear();
+    cullInstances.resize(instanceCount);
+    if (cullingMode == CullingMode::Cpu) culler.resize(instanceCount);
+    for (uint32_t g = 0; g < cullGroups.size(); g++) {
+        const CullGroup& group = cullGroups[g];
+
+        CullInstance instance{};
+        instance.sphere = group.sphere;
+        instance.firstDraw = static_cast<uint32_t>(cullDrawRefs.size());
+        instance.drawCount = static_cast<uint32_t>(groupDraws[g].size());
+        instance.firstInstance = group.firstInstance;
+
+        cullDrawRefs.insert(cullDrawRefs.end(), groupDraws[g].begin(),
+                            groupDraws[g].end());
+
+        for (uint32_t i = 0; i < group.instanceCount; i++)
+            cullInstances[group.firstInstance + i] = instance;
+    }
+}
+
+void VulkanAPI::recordDrawCommands(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+    frame.batchListVersion = batchListVersion;
+    frame.recordedObjectOffset = frame.objectOffset;
+
+    const std::vector<DrawBatch>& batches = renderQueue.getBatches();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Split by draws rather than batches, which merge every mesh drawn with
+    // the same pipeline and texture
+    size_t drawCount = 0;
+    for (const DrawBatch& batch : batches)
+        if (!batch.pushConstants) drawCount += batch.drawCount;
+
+    // Small draw lists aren't worth the cost of waking up other threads
+    size_t threads =
+        (drawCount + MIN_DRAWS_PER_THREAD - 1) / MIN_DRAWS_PER_THREAD;
+    threads = std::clamp<size_t>(threads, 1, frame.drawCommands.size());
+
+    size_t chunkSize = (drawCount + threads - 1) / threads;
+
+    std::vector<RenderStats> threadStats(threads);
+    recordingPool.run(static_cast<uint32_t>(threads), [&](uint32_t thread) {
+        size_t begin = std::min(thread * chunkSize, drawCount);
+        size_t end = std::min(begin + chunkSize, drawCount);
+        threadStats[thread] = recordDrawRange(frameIndex, thread, begin, end);
+    });
+
+    RenderStats recordStats{};
+    for (const RenderStats& threadStat : threadStats) {
+        recordStats.draws += threadStat.draws;
+        recordStats.instances += threadStat.instances;
+        recordStats.binds += threadStat.binds;
+        recordStats.skippedBinds += threadStat.skippedBinds;
+    }
+
+    frame.activeDrawCommands = static_cast<uint32_t>(threads);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    stats.draws = recordStats.draws;
+    stats.instances = recordStats.instances;
+    stats.binds = recordStats.binds;
+    stats.skippedBinds = recordStats.skippedBinds;
+    stats.recordMilliseconds =
+        std::chrono::duration<float, std::milli>(end - start).count();
+    ASH_TRACE(
+        "Recorded {} draws of {} instances with {} binds in {:.3f}ms, skipped "
+        "{} redundant binds",
+        stats.draws, stats.instances, stats.binds, stats.recordMilliseconds,
+        stats.skippedBinds);
+}
+
+void VulkanAPI::beginDrawCommands(VkCommandBuffer commandBuffer,
+                                  size_t frameIndex, RenderStats& recordStats) {
+    FrameData& frame = frames[frameIndex];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    ASH_ASSERT(vkBeginCommandBuffer(commandBuffer, &beginInfo) == VK_SUCCESS,
+               "Failed to begin draw command buffer");
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapchainExtent.width;
+    viewport.height = (float)swapchainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapchainExtent;
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkDeviceSize offsets[] = {0};
+
+    // All pipelines share a layout, so the object buffer stays bound across
+    // pipeline changes
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1,
+                            &uboDescriptorSets[frameIndex], 1,
+                            &frame.objectOffset);
+    recordStats.binds++;
+
+    // Every mesh lives in the shared geometry buffers, draws pick theirs
+    // with offsets
+    VkBuffer vb[] = {vertexGeometry.buffer};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vb, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexGeometry.buffer, 0,
+                         VK_INDEX_TYPE_UINT32);
+    recordStats.binds += 2;
+}
+
+RenderStats VulkanAPI::recordDrawRange(size_t frameIndex, size_t thread,
+                                       size_t begin, size_t end) {
+    FrameData& frame = frames[frameIndex];
+    VkCommandBuffer commandBuffer = frame.drawCommands[thread];
+
+    vkResetCommandPool(device, frame.drawCommandPools[thread], 0);
+
+    RenderStats rangeStats{};
+    beginDrawCommands(commandBuffer, frameIndex, rangeStats);
+
+    // Draws are sorted by pipeline and texture, so only rebind when the
+    // state actually changes
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet boundTexture = VK_NULL_HANDLE;
+
+    // Compressed vertices find their draw's quantisation at this index plus
+    // gl_DrawIDARB, which only counts up within a multi-draw
+    auto pushFirstDraw = [&](uint32_t firstDraw) {
+        if (!vertexCompression) return;
+        vkCmdPushConstants(commandBuffer, pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           offsetof(DrawConstants, firstDraw),
+                           sizeof(uint32_t), &firstDraw);
+    };
+
+    // The range counts the draws of every batch that isn't drawn with push
+    // constants, which are recorded every frame in a buffer of their own
+    const std::vector<DrawCall>& draws = renderQueue.getDraws();
+    const std::vector<DrawBatch>& batches = renderQueue.getBatches();
+    size_t batchBegin = 0;
+    for (const DrawBatch& batch : batches) {
+        if (batchBegin >= end) break;
+        if (batch.pushConstants) continue;
+
+        // Large batches are split between threads
+        size_t from = std::max(begin, batchBegin);
+        size_t to = std::min(end, batchBegin + batch.drawCount);
+        uint32_t firstDraw =
+            batch.firstDraw + static_cast<uint32_t>(from - batchBegin);
+        batchBegin += batch.drawCount;
+        if (from >= to) continue;
+
+        uint32_t drawCount = static_cast<uint32_t>(to - from);
+
+        if (batch.pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              batch.pipeline);
+            boundPipeline = batch.pipeline;
+            rangeStats.binds++;
+        } else {
+            rangeStats.skippedBinds++;
+        }
+
+        if (batch.textureSet != boundTexture) {
+            vkCmdBindDescriptorSets(
+                commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                1, 1, &batch.textureSet, 0, nullptr);
+            boundTexture = batch.textureSet;
+            rangeStats.binds++;
+        } else {
+            rangeStats.skippedBinds++;
+        }
+
+        for (uint32_t j = 0; j < drawCount; j++)
+            rangeStats.instances += draws[firstDraw + j].instanceCount;
+
+        if (!indirectDrawing) {
+            for (uint32_t j = 0; j < drawCount; j++) {
+                const DrawCall& draw = draws[firstDraw + j];
+                pushFirstDraw(firstDraw + j);
+                vkCmdDrawIndexed(commandBuffer, draw.indexCount,
+                                 draw.instanceCount, draw.firstIndex,
+                                 draw.vertexOffset, draw.firstInstance);
+                rangeStats.draws++;
+            }
+            continue;
+        }
+
+        VkBuffer indirectBuffer = cullingMode == CullingMode::Gpu
+                                      ? frame.culledIndirectBuffer
+                                      : frame.indirectBuffer;
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        VkDeviceSize offset = firstDraw * stride;
+        if (multiDrawIndirect) {
+            pushFirstDraw(firstDraw);
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, offset,
+                                     drawCount, stride);
+            rangeStats.draws++;
+        } else {
+            for (uint32_t j = 0; j < drawCount; j++) {
+                pushFirstDraw(firstDraw + j);
+                vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer,
+                                         offset + j * stride, 1, stride);
+                rangeStats.draws++;
             }
         }
+    }
+
+    ASH_ASSERT(vkEndCommandBuffer(commandBuffer) == VK_SUCCESS,
+               "Failed to record draw command buffer {}", thread);
+
+    return rangeStats;
+}
+
+void VulkanAPI::recordPushConstantDraws(size_t frameIndex) {
+    FrameData& frame = frames[frameIndex];
+    VkCommandBuffer commandBuffer = frame.pushCommands;
+
+    RenderStats pushStats{};
+    beginDrawCommands(commandBuffer, frameIndex, pushStats);
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet boundTexture = VK_NULL_HANDLE;
+
+    // Neither culled nor drawn indirectly, every instance is its own draw
+    const std::vector<DrawCall>& draws = renderQueue.getDraws();
+    for (const DrawBatch& batch : renderQueue.getBatches()) {
+        if (!batch.pushConstants) continue;
+
+        if (batch.pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              batch.pipeline);
+            boundPipeline = batch.pipeline;
+        }
 
-        vkCmdEndRenderPass(commandBuffers[i]);
+        if (batch.textureSet != boundTexture) {
+            vkCmdBindDescriptorSets(
+                commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                1, 1, &batch.textureSet, 0, nullptr);
+            boundTexture = batch.textureSet;
+        }
 
-        ASH_ASSERT(vkEndCommandBuffer(commandBuffers[i]) == VK_SUCCESS,
-                   "Failed to record command buffer {}", i);
+        for (uint32_t j = 0; j < batch.drawCount; j++) {
+            const DrawCall& draw = draws[batch.firstDraw + j];
+            DrawConstants constants{};
+            constants.firstDraw = batch.firstDraw + j;
+            for (uint32_t k = 0; k < draw.instanceCount; k++) {
+                constants.model = instanceModels[draw.firstInstance + k];
+                vkCmdPushConstants(commandBuffer, pipelineLayout,
+                                   VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                   sizeof(DrawConstants), &constants);
+                vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1,
+                                 draw.firstIndex, draw.vertexOffset, 0);
+                pushStats.draws++;
+            }
+        }
     }
+
+    ASH_ASSERT(vkEndCommandBuffer(commandBuffer) == VK_SUCCESS,
+               "Failed to record push constant draws");
+
+    stats.pushConstantDraws = pushStats.draws;
 }
 
 void VulkanAPI::createSyncObjects() {
@@ -1209,10 +2133,6 @@ void VulkanAPI::createSyncObjects() {
                                  &inFlightFences[i]) == VK_SUCCESS,
                    "Failed to create fence");
     }
-
-    ASH_ASSERT(vkCreateFence(device, &fenceInfo, nullptr, &copyFinishedFence) ==
-                   VK_SUCCESS,
-               "Failed to create fence");
 }
 
 void VulkanAPI::cleanupSwapchain() {
@@ -1222,18 +2142,12 @@ void VulkanAPI::cleanupSwapchain() {
     for (auto framebuffer : swapchainFramebuffers)
         vkDestroyFramebuffer(device, framebuffer, nullptr);
 
-    vkFreeCommandBuffers(device, commandPool,
-                         static_cast<uint32_t>(commandBuffers.size()),
-                         commandBuffers.data());
-
     vkDestroyRenderPass(device, renderPass, nullptr);
 
     for (auto imageView : swapchainImageViews)
         vkDestroyImageView(device, imageView, nullptr);
 
     vkDestroySwapchainKHR(device, swapchain, nullptr);
-
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 }
 
 void VulkanAPI::recreateSwapchain() {
@@ -1255,27 +2169,17 @@ void VulkanAPI::recreateSwapchain() {
     createRenderPass();
     createDepthResources();
     createFramebuffers();
-    createDescriptorPool(MAX_INSTANCES);
 
-    std::shared_ptr<Scene> scene = Renderer::getScene();
-    auto renderables = scene->registry.view<Renderable>();
-    for (auto entity : renderables) {
-        auto& renderable = renderables.get(entity);
-        for (uint32_t i = 0;
-             i < Renderer::getModel(renderable.model).meshes.size(); i++) {
-            createDescriptorSets(
-                renderable.descriptorSets[i],
-                Renderer::getTexture(
-                    Renderer::getModel(renderable.model).textures[i]));
-        }
-    }
+    imagesInFlight.assign(swapchainImages.size(), VK_NULL_HANDLE);
 
-    createCommandBuffers();
+    // Draw commands inherit the render pass and bake in the viewport
+    drawListVersion++;
+    batchListVersion++;
 }
 
 void VulkanAPI::createBuffer(VkDeviceSize size, VmaMemoryUsage memUsage,
                              VkBufferUsageFlags usage, VkBuffer& buffer,
-                             VmaAllocation& allocation) {
+                             VmaAllocation& allocation, void** mapped) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -1284,44 +2188,14 @@ void VulkanAPI::createBuffer(VkDeviceSize size, VmaMemoryUsage memUsage,
 
     VmaAllocationCreateInfo allocationInfo{};
     allocationInfo.usage = memUsage;
+    if (mapped) allocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
+    VmaAllocationInfo info{};
     ASH_ASSERT(vmaCreateBuffer(allocator, &bufferInfo, &allocationInfo, &buffer,
-                               &allocation, nullptr) == VK_SUCCESS,
+                               &allocation, &info) == VK_SUCCESS,
                "Failed to create buffer and allocation");
-}
-
-void VulkanAPI::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
-                           VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-void VulkanAPI::copyBufferToImage(VkBuffer buffer, VkImage image,
-                                  uint32_t width, uint32_t height) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    endSingleTimeCommands(commandBuffer);
+    if (mapped) *mapped = info.pMappedData;
 }
 
 VkShaderModule VulkanAPI::createShaderModule(const std::vector<char>& code) {
@@ -1341,14 +2215,15 @@ VkShaderModule VulkanAPI::createShaderModule(const std::vector<char>& code) {
 void VulkanAPI::createImage(uint32_t width, uint32_t height,
                             VmaMemoryUsage memUsage, VkFormat format,
                             VkImageTiling tiling, VkImageUsageFlags usage,
-                            VkImage& image, VmaAllocation& allocation) {
+                            VkImage& image, VmaAllocation& allocation,
+                            uint32_t mipLevels) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = static_cast<uint32_t>(width);
     imageInfo.extent.height = static_cast<uint32_t>(height);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
@@ -1367,9 +2242,18 @@ void VulkanAPI::createImage(uint32_t width, uint32_t height,
 
 void VulkanAPI::transitionImageLayout(VkImage image, VkFormat format,
                                       VkImageLayout oldLayout,
-                                      VkImageLayout newLayout) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+                                      VkImageLayout newLayout,
+                                      uint32_t mipLevels) {
+    recordImageTransition(uploads.getCommandBuffer(), image, format,
+                          oldLayout, newLayout, 0, mipLevels);
+}
 
+void VulkanAPI::recordImageTransition(VkCommandBuffer commandBuffer,
+                                      VkImage image, VkFormat format,
+                                      VkImageLayout oldLayout,
+                                      VkImageLayout newLayout,
+                                      uint32_t baseMipLevel,
+                                      uint32_t levelCount) {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -1387,8 +2271,8 @@ void VulkanAPI::transitionImageLayout(VkImage image, VkFormat format,
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     }
 
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = levelCount;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
     barrier.srcAccessMask = 0;  // TODO
@@ -1409,6 +2293,20 @@ void VulkanAPI::transitionImageLayout(VkImage image, VkFormat format,
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
+        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+               newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL &&
+               newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
         sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
@@ -1426,59 +2324,167 @@ void VulkanAPI::transitionImageLayout(VkImage image, VkFormat format,
 
     vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0,
                          nullptr, 0, nullptr, 1, &barrier);
-
-    endSingleTimeCommands(commandBuffer);
 }
 
 void VulkanAPI::createTextureImage(const std::string& path, Texture& texture) {
     ASH_INFO("Loading texture {}", path);
 
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight,
-                                &texChannels, STBI_rgb_alpha);
+    TextureDecoder::Image image{};
+    image.name = texture.name;
+    image.path = path;
+    TextureDecoder::decode(image);
+
+    ASH_ASSERT(image.isLoaded(), "Failed to load image from disk");
 
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+    if (image.isCompressed()) {
+        ASH_ASSERT(textureCompressionBC, "BC textures aren't supported");
 
-    ASH_ASSERT(pixels, "Failed to load image from disk");
+        texture.format = image.ktx.format;
+        texture.mipLevels = recordCompressedUpload(image.ktx, texture.image,
+                                                   texture.imageAllocation);
+    } else {
+        texture.mipLevels =
+            recordTextureUpload(image.pixels, image.width, image.height,
+                                texture.image, texture.imageAllocation);
+    }
 
-    VkBuffer stagingBuffer;
-    VmaAllocation stagingBufferAllocation;
+    TextureDecoder::release(image);
 
-    createBuffer(imageSize, VMA_MEMORY_USAGE_CPU_ONLY,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingBuffer,
-                 stagingBufferAllocation);
+    createTextureImageView(texture);
+    createTextureDescriptorSet(texture);
 
-    void* data;
-    vmaMapMemory(allocator, stagingBufferAllocation, &data);
-    std::memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vmaUnmapMemory(allocator, stagingBufferAllocation);
+    textures.push_back(texture);
+}
 
-    stbi_image_free(pixels);
+uint32_t VulkanAPI::recordTextureUpload(const uint8_t* pixels, uint32_t width,
+                                       uint32_t height, VkImage& image,
+                                       VmaAllocation& allocation) {
+    uint32_t mipLevels = std::bit_width(std::max(width, height));
 
-    createImage(texWidth, texHeight, VMA_MEMORY_USAGE_GPU_ONLY,
+    createImage(width, height, VMA_MEMORY_USAGE_GPU_ONLY,
                 VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                texture.image, texture.imageAllocation);
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                image, allocation, mipLevels);
 
-    transitionImageLayout(texture.image, VK_FORMAT_R8G8B8A8_SRGB,
+    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
                           VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(stagingBuffer, texture.image,
-                      static_cast<uint32_t>(texWidth),
-                      static_cast<uint32_t>(texHeight));
-    transitionImageLayout(texture.image, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+
+    if (blitMipmaps) {
+        size_t size = size_t(width) * height * 4;
+        UploadContext::Staging staging = uploads.stage(size);
+        std::memcpy(staging.data, pixels, size);
+        uploads.copyBufferToImage(staging, image, width, height);
+
+        recordMipmapBlits(image, width, height, mipLevels);
+        return mipLevels;
+    }
+
+    std::vector<uint8_t> level;
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        if (i > 0) {
+            level = Helper::downsampleImage(pixels, width, height);
+            pixels = level.data();
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+
+        size_t size = size_t(width) * height * 4;
+        UploadContext::Staging staging = uploads.stage(size);
+        std::memcpy(staging.data, pixels, size);
+        uploads.copyBufferToImage(staging, image, width, height, i);
+    }
+
+    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+    return mipLevels;
+}
 
-    vmaDestroyBuffer(allocator, stagingBuffer, stagingBufferAllocation);
+void VulkanAPI::recordMipmapBlits(VkImage image, uint32_t width,
+                                  uint32_t height, uint32_t mipLevels) {
+    VkCommandBuffer commandBuffer = uploads.getCommandBuffer();
+
+    int32_t mipWidth = static_cast<int32_t>(width);
+    int32_t mipHeight = static_cast<int32_t>(height);
+
+    // Each level is read from the one above it, which is handed over to the
+    // shaders once it has been read
+    for (uint32_t i = 1; i < mipLevels; i++) {
+        recordImageTransition(commandBuffer, image, VK_FORMAT_R8G8B8A8_SRGB,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+
+        mipWidth = std::max(mipWidth / 2, 1);
+        mipHeight = std::max(mipHeight / 2, 1);
+
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+
+        // sRGB images are filtered in linear space
+        vkCmdBlitImage(commandBuffer, image,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                       VK_FILTER_LINEAR);
+
+        recordImageTransition(commandBuffer, image, VK_FORMAT_R8G8B8A8_SRGB,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, i - 1);
+    }
 
-    createTextureImageView(texture);
+    recordImageTransition(commandBuffer, image, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          mipLevels - 1);
+}
 
-    textures.push_back(texture);
+uint32_t VulkanAPI::recordCompressedUpload(const Ktx::Image& ktx,
+                                          VkImage& image,
+                                          VmaAllocation& allocation) {
+    uint32_t mipLevels = static_cast<uint32_t>(ktx.levels.size());
+
+    createImage(ktx.width, ktx.height, VMA_MEMORY_USAGE_GPU_ONLY, ktx.format,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                image, allocation, mipLevels);
+
+    transitionImageLayout(image, ktx.format, VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+
+    // Level offsets are block aligned, as are offsets into the ring
+    UploadContext::Staging staging = uploads.stage(ktx.data.size());
+    std::memcpy(staging.data, ktx.data.data(), ktx.data.size());
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        const Ktx::Level& level = ktx.levels[i];
+        UploadContext::Staging region = staging;
+        region.offset += level.offset;
+        uploads.copyBufferToImage(region, image, level.width, level.height,
+                                  i);
+    }
+
+    transitionImageLayout(image, ktx.format,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+    return mipLevels;
 }
 
 VkImageView VulkanAPI::createImageView(VkImage image, VkFormat format,
-                                       VkImageAspectFlags aspectFlags) {
+                                       VkImageAspectFlags aspectFlags,
+                                       uint32_t mipLevels) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -1486,7 +2492,7 @@ VkImageView VulkanAPI::createImageView(VkImage image, VkFormat format,
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -1497,9 +2503,94 @@ VkImageView VulkanAPI::createImageView(VkImage image, VkFormat format,
     return imageView;
 }
 
+void VulkanAPI::loadTextureAsync(const std::string& path, Texture& texture) {
+    ASH_INFO("Streaming texture {}", path);
+
+    if (!textureDecoder.isRunning())
+        textureDecoder.start(
+            std::max(std::thread::hardware_concurrency() / 2, 1u));
+
+    textureDecoder.push(texture.name, path);
+}
+
+void VulkanAPI::streamTextures() {
+    // Only one batch is in flight, the next one is recorded once it's done
+    if (!textureUploads.empty()) {
+        if (!uploads.isComplete(textureBatch)) return;
+        finishTextureUploads();
+    }
+
+    textureDecoder.collect(decodedTextures);
+    if (decodedTextures.empty()) return;
+
+    VkDeviceSize batchSize = 0;
+    size_t consumed = 0;
+    for (TextureDecoder::Image& image : decodedTextures) {
+        if (batchSize > 0 && batchSize + image.size() > TEXTURE_UPLOAD_BUDGET)
+            break;
+        consumed++;
+
+        // The texture keeps its placeholder
+        if (!image.isLoaded()) {
+            ASH_WARN("Failed to load image {} from disk", image.path);
+            continue;
+        }
+        if (image.isCompressed() && !textureCompressionBC) {
+            ASH_WARN("Can't sample {}, BC textures aren't supported",
+                     image.path);
+            TextureDecoder::release(image);
+            continue;
+        }
+        batchSize += image.size();
+
+        TextureUpload upload{};
+        upload.name = image.name;
+        if (image.isCompressed()) {
+            upload.format = image.ktx.format;
+            upload.mipLevels = recordCompressedUpload(
+                image.ktx, upload.image, upload.allocation);
+        } else {
+            upload.format = VK_FORMAT_R8G8B8A8_SRGB;
+            upload.mipLevels =
+                recordTextureUpload(image.pixels, image.width, image.height,
+                                    upload.image, upload.allocation);
+        }
+        TextureDecoder::release(image);
+
+        textureUploads.push_back(upload);
+    }
+    decodedTextures.erase(decodedTextures.begin(),
+                          decodedTextures.begin() + consumed);
+
+    // Submitted with this frame but never waited on, the textures are
+    // swapped in on a later frame once the batch has completed
+    textureBatch = uploads.getBatch();
+}
+
+void VulkanAPI::finishTextureUploads() {
+    for (const TextureUpload& upload : textureUploads) {
+        Texture& texture = Renderer::getTexture(upload.name);
+        texture.image = upload.image;
+        texture.imageAllocation = upload.allocation;
+        texture.format = upload.format;
+        texture.mipLevels = upload.mipLevels;
+        createTextureImageView(texture);
+        createTextureDescriptorSet(texture);
+
+        textures.push_back(texture);
+    }
+
+    ASH_INFO("Streamed in {} textures", textureUploads.size());
+    textureUploads.clear();
+
+    // Draws still point at the placeholder's descriptor set
+    drawListVersion++;
+}
+
 void VulkanAPI::createTextureImageView(Texture& texture) {
-    texture.imageView = createImageView(texture.image, VK_FORMAT_R8G8B8A8_SRGB,
-                                        VK_IMAGE_ASPECT_COLOR_BIT);
+    texture.imageView =
+        createImageView(texture.image, texture.format,
+                        VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels);
 }
 
 void VulkanAPI::createTextureSampler() {
@@ -1511,10 +2602,7 @@ void VulkanAPI::createTextureSampler() {
     samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.anisotropyEnable = VK_TRUE;
-
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+    samplerInfo.maxAnisotropy = deviceProperties.limits.maxSamplerAnisotropy;
 
     samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
@@ -1523,7 +2611,8 @@ void VulkanAPI::createTextureSampler() {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    // Shared by every texture, whatever the length of its mip chain
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     ASH_ASSERT(vkCreateSampler(device, &samplerInfo, nullptr,
                                &textureSampler) == VK_SUCCESS,
@@ -1553,10 +2642,14 @@ void VulkanAPI::init(const std::vector<Pipeline>& pipelines) {
     createPipelineCache();
     createDescriptorSetLayout();
     createGraphicsPipelines(pipelines);
-    createDescriptorPool(MAX_INSTANCES);
+    if (cullingMode == CullingMode::Gpu) createCullPipeline();
+    createDescriptorPool(MAX_TEXTURES);
+    createCommandPools();
     createUniformBuffers();
+    createGeometryBuffers();
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) createDrawBuffers(i);
     createDescriptorSets();
-    createCommandPools();
+    if (cullingMode == CullingMode::Gpu) createCullDescriptorSets();
     createDepthResources();
     createFramebuffers();
     createCommandBuffers();
@@ -1565,59 +2658,111 @@ void VulkanAPI::init(const std::vector<Pipeline>& pipelines) {
 }
 
 void VulkanAPI::updateUniformBuffers(uint32_t currentImage) {
-    UniformBufferObject ubo{};
-    ubo.model = glm::rotate(glm::mat4(1.0f), 0.0f, glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view =
+    CameraData camera{};
+    camera.view =
         glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f),
                     glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.proj = glm::perspective(
+    camera.proj = glm::perspective(
         glm::radians(45.0f),
         swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f);
 
-    ubo.proj[1][1] *= -1;
+    camera.proj[1][1] *= -1;
 
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    camera.viewProj = camera.proj * camera.view;
+    viewProjection = camera.viewProj;
 
-    size_t minUniformBufferAllignment =
-        properties.limits.minUniformBufferOffsetAlignment;
-    size_t dynamicAllignment = sizeof(UniformBufferObject);
-
-    dynamicAllignment = calculateDynamicAllignment(minUniformBufferAllignment,
-                                                   dynamicAllignment);
+    FrameData& frame = frames[currentImage];
+    *frame.cameraData = camera;
+    vmaFlushAllocation(allocator, frame.cameraAllocation, 0, VK_WHOLE_SIZE);
 
     std::shared_ptr<Scene> scene = Renderer::getScene();
     if (scene) {
-        auto renderables = scene->registry.view<Renderable, Transform>();
-        int i = 0;
-        for (auto entity : renderables) {
-            auto [renderable, transform] =
-                renderables.get<Renderable, Transform>(entity);
-
-            ubo.model = transform.getTransform();
-
-            char* data;
-            vmaMapMemory(allocator,
-                         uniformBuffers[currentImage].uniformBufferAllocation,
-                         (void**)&data);
+        const std::vector<entt::entity>& instances =
+            renderQueue.getInstances();
+
+        // The frame's fence has been waited on, so its region is free again
+        objectRing.beginRegion(currentImage);
+        RingBuffer::Allocation objects = objectRing.allocate(
+            sizeof(ObjectData) * dynamicInstances.size(),
+            deviceProperties.limits.minStorageBufferOffsetAlignment);
+        frame.objectOffset = static_cast<uint32_t>(objects.offset);
+
+        // Only dynamic objects, written straight into mapped memory
+        ObjectData* data = static_cast<ObjectData*>(objects.data);
+
+        bool cpuCulling = cullingMode == CullingMode::Cpu;
+
+        // Every frame in flight queues the change for its next turn
+        for (entt::entity entity : changedEntities) {
+            // Transform-only entities, like a moved parent, are queued too
+            // and may have been destroyed since
+            auto pushObject = pushObjects.find(entity);
+            auto object = dynamicObjects.find(entity);
+            if (pushObject == pushObjects.end() &&
+                object == dynamicObjects.end())
+                continue;
+            if (!scene->registry.valid(entity)) continue;
+
+            WorldTransform* transform =
+                scene->registry.try_get<WorldTransform>(entity);
+            glm::mat4 model = transform ? transform->matrix : glm::mat4(1.0f);
+
+            // Picked up by the next recording of the push constant draws
+            if (pushObject != pushObjects.end()) {
+                instanceModels[pushObject->second] = model;
+                continue;
+            }
 
-            data += i * dynamicAllignment;
+            uint32_t i = object->second;
+            if (cpuCulling) setCullSphere(i, model);
 
-            std::memcpy(data, &ubo, sizeof(ubo));
+            for (FrameData& queued : frames) {
+                if (queued.objectListVersion != objectListVersion ||
+                    queued.objectChanged[i])
+                    continue;
 
-            vmaUnmapMemory(
-                allocator,
-                uniformBuffers[currentImage].uniformBufferAllocation);
-            i++;
+                queued.objectChanged[i] = 1;
+                queued.changedObjects.push_back(i);
+            }
+        }
+        changedEntities.clear();
+
+        auto writeObject = [&](uint32_t i) {
+            WorldTransform* transform =
+                scene->registry.try_get<WorldTransform>(instances[i]);
+            data[objectIndices[i]].model =
+                transform ? transform->matrix : glm::mat4(1.0f);
+        };
+
+        if (frame.objectListVersion != objectListVersion) {
+            // Written in one linear pass
+            frame.objectListVersion = objectListVersion;
+            frame.changedObjects.clear();
+            frame.objectChanged.assign(instances.size(), 0);
+
+            for (uint32_t i : dynamicInstances) writeObject(i);
+            stats.uploadedObjects =
+                static_cast<uint32_t>(dynamicInstances.size());
+        } else {
+            for (uint32_t i : frame.changedObjects) {
+                writeObject(i);
+                frame.objectChanged[i] = 0;
+            }
+            stats.uploadedObjects =
+                static_cast<uint32_t>(frame.changedObjects.size());
+            frame.changedObjects.clear();
         }
+
+        objectRing.flush();
     }
 }
 
 void VulkanAPI::render() {
-    updateCommandBuffers();
-
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE,
                     UINT64_MAX);
+    destroyRetiredBuffers();
+    streamTextures();
+
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(
         device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
@@ -1637,7 +2782,13 @@ void VulkanAPI::render() {
 
     imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
-    updateUniformBuffers(imageIndex);
+    // Uniform slots follow the queue, so it has to be current before either
+    // the uniforms or the draw commands are written
+    if (renderQueueVersion != drawListVersion) buildRenderQueue();
+    reserveInstances(currentFrame);
+
+    updateUniformBuffers(currentFrame);
+    recordCommandBuffer(imageIndex);
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1649,12 +2800,16 @@ void VulkanAPI::render() {
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &frames[currentFrame].commandBuffer;
 
     VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
+    // Everything recorded since the last frame goes in one submission ahead
+    // of the frame
+    uploads.submit();
+
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
     ASH_ASSERT(vkQueueSubmit(graphicsQueue, 1, &submitInfo,
@@ -1684,6 +2839,7 @@ void VulkanAPI::render() {
     }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frameNumber++;
 }
 
 void VulkanAPI::cleanup() {
@@ -1691,6 +2847,15 @@ void VulkanAPI::cleanup() {
 
     ASH_INFO("Cleaning up graphics API");
 
+    // Waits for anything still recorded, so streamed textures are done
+    uploads.destroy();
+    textureDecoder.stop();
+    recordingPool.stop();
+    for (TextureDecoder::Image& image : decodedTextures)
+        TextureDecoder::release(image);
+    decodedTextures.clear();
+    if (!textureUploads.empty()) finishTextureUploads();
+
     vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
     cleanupSwapchain();
@@ -1707,15 +2872,35 @@ void VulkanAPI::cleanup() {
 
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-    for (auto buffer : uniformBuffers) {
-        vmaDestroyBuffer(allocator, buffer.uniformBuffer,
-                         buffer.uniformBufferAllocation);
+    if (cullingMode == CullingMode::Gpu) {
+        vkDestroyPipeline(device, cullPipeline, nullptr);
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
     }
 
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    objectRing.destroy();
+    vmaDestroyBuffer(allocator, staticObjectBuffer, staticObjectAllocation);
+
+    // The device is idle, so nothing reads these anymore
+    for (const RetiredBuffer& retired : retiredBuffers)
+        vmaDestroyBuffer(allocator, retired.buffer, retired.allocation);
+    retiredBuffers.clear();
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
-    for (IndexedVertexBuffer ivb : indexedVertexBuffers) {
-        vmaDestroyBuffer(allocator, ivb.buffer, ivb.bufferAllocation);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, imageDescriptorSetLayout, nullptr);
+
+    vmaDestroyBuffer(allocator, vertexGeometry.buffer,
+                     vertexGeometry.allocation);
+    vmaDestroyBuffer(allocator, indexGeometry.buffer,
+                     indexGeometry.allocation);
+    retiredGeometry.clear();
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        vmaDestroyBuffer(allocator, frames[i].cameraBuffer,
+                         frames[i].cameraAllocation);
+        destroyDrawBuffers(i);
     }
 
     vmaDestroyAllocator(allocator);
@@ -1726,10 +2911,11 @@ void VulkanAPI::cleanup() {
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
 
-    vkDestroyFence(device, copyFinishedFence, nullptr);
-
-    vkDestroyCommandPool(device, commandPool, nullptr);
-    vkDestroyCommandPool(device, transferCommandPool, nullptr);
+    for (FrameData& frame : frames) {
+        vkDestroyCommandPool(device, frame.commandPool, nullptr);
+        for (VkCommandPool pool : frame.drawCommandPools)
+            vkDestroyCommandPool(device, pool, nullptr);
+    }
 
     vkDestroyDevice(device, nullptr);
 
@@ -1740,12 +2926,6 @@ void VulkanAPI::cleanup() {
     vkDestroyInstance(instance, nullptr);
 }
 
-void VulkanAPI::updateCommandBuffers() {
-    vkQueueWaitIdle(graphicsQueue);
-    vkResetCommandPool(device, commandPool, 0);
-    recordCommandBuffers();
-}
-
 VkFormat VulkanAPI::findSupportedFormat(const std::vector<VkFormat>& candidates,
                                         VkImageTiling tiling,
                                         VkFormatFeatureFlags features) {
@@ -1799,43 +2979,236 @@ void VulkanAPI::createDepthResources() {
 
 void VulkanAPI::setClearColor(const glm::vec4& color) { clearColor = color; }
 
+const RenderStats& VulkanAPI::getStats() const { return stats; }
+
+void VulkanAPI::setRecordingThreads(uint32_t count) {
+    ASH_ASSERT(frames.empty(),
+               "Recording threads must be set before the renderer is "
+               "initialized");
+
+    if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+    recordingThreads = count;
+}
+
+void VulkanAPI::setIndirectDrawing(bool enabled) {
+    ASH_ASSERT(frames.empty(),
+               "Indirect drawing must be set before the renderer is "
+               "initialized");
+
+    indirectDrawing = enabled;
+}
+
+void VulkanAPI::setVertexCompression(bool enabled) {
+    ASH_ASSERT(frames.empty(),
+               "Vertex compression must be set before the renderer is "
+               "initialized");
+
+    vertexCompression = enabled;
+    vertexStride = enabled ? sizeof(CompressedVertex) : sizeof(Vertex);
+}
+
+void VulkanAPI::setMainPushConstants(bool enabled) {
+    ASH_ASSERT(frames.empty(),
+               "Main pipeline push constants must be set before the renderer "
+               "is initialized");
+
+    mainPushConstants = enabled;
+}
+
+void VulkanAPI::setCullingMode(CullingMode mode) {
+    ASH_ASSERT(frames.empty(),
+               "Culling mode must be set before the renderer is initialized");
+
+    cullingMode = mode;
+    if (mode != CullingMode::None) indirectDrawing = true;
+}
+
+void VulkanAPI::trackScene(Scene& scene) {
+    scene.registry.on_construct<Renderable>()
+        .connect<&VulkanAPI::onDrawListChanged>(*this);
+    scene.registry.on_update<Renderable>()
+        .connect<&VulkanAPI::onDrawListChanged>(*this);
+    scene.registry.on_destroy<Renderable>()
+        .connect<&VulkanAPI::onDrawListChanged>(*this);
+    scene.registry.on_construct<Static>()
+        .connect<&VulkanAPI::onDrawListChanged>(*this);
+    scene.registry.on_destroy<Static>()
+        .connect<&VulkanAPI::onDrawListChanged>(*this);
+    scene.registry.on_update<WorldTransform>()
+        .connect<&VulkanAPI::onTransformChanged>(*this);
+    scene.registry.on_destroy<WorldTransform>()
+        .connect<&VulkanAPI::onTransformChanged>(*this);
+
+    drawListVersion++;
+}
+
+void VulkanAPI::untrackScene(Scene& scene) {
+    scene.registry.on_construct<Renderable>().disconnect(*this);
+    scene.registry.on_update<Renderable>().disconnect(*this);
+    scene.registry.on_destroy<Renderable>().disconnect(*this);
+    scene.registry.on_construct<Static>().disconnect(*this);
+    scene.registry.on_destroy<Static>().disconnect(*this);
+    scene.registry.on_update<WorldTransform>().disconnect(*this);
+    scene.registry.on_destroy<WorldTransform>().disconnect(*this);
+
+    drawListVersion++;
+}
+
+void VulkanAPI::onDrawListChanged(entt::registry&, entt::entity) {
+    drawListVersion++;
+}
+
+void VulkanAPI::onTransformChanged(entt::registry&, entt::entity entity) {
+    changedEntities.push_back(entity);
+}
+
 IndexedVertexBuffer VulkanAPI::createIndexedVertexArray(
-    const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices) {
+    const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices,
+    const Bounds& bounds) {
+    return createIndexedVertexArray(verts.data(), sizeof(Vertex) * verts.size(),
+                                    indices.data(),
+                                    static_cast<uint32_t>(indices.size()),
+                                    bounds);
+}
+
+IndexedVertexBuffer VulkanAPI::createIndexedVertexArray(
+    const void* verts, VkDeviceSize vertSize, const uint32_t* indices,
+    uint32_t numIndices, const Bounds& bounds) {
     IndexedVertexBuffer ret{};
-    ret.numIndices = indices.size();
+    ret.numIndices = numIndices;
+
+    size_t vertexCount = static_cast<size_t>(vertSize / sizeof(Vertex));
+    VkDeviceSize uploadSize = vertexCount * vertexStride;
+    VkDeviceSize indicesSize = sizeof(uint32_t) * numIndices;
+
+    // Aligned to whole vertices and indices, so the offsets can be passed to
+    // the draws as they are
+    ret.vertices = allocateGeometry(vertexGeometry, uploadSize, vertexStride);
+    ret.indices =
+        allocateGeometry(indexGeometry, indicesSize, sizeof(uint32_t));
+
+    UploadContext::Staging staging = uploads.stage(uploadSize + indicesSize);
+    if (vertexCompression) {
+        // Quantised straight into staging memory
+        Helper::compressVertices(static_cast<const Vertex*>(verts),
+                                 vertexCount, bounds,
+                                 static_cast<CompressedVertex*>(staging.data));
+        ret.positionScale = bounds.max - bounds.min;
+        ret.positionOffset = bounds.min;
+    } else {
+        std::memcpy(staging.data, verts, static_cast<size_t>(vertSize));
+    }
+    std::memcpy(static_cast<uint8_t*>(staging.data) + uploadSize, indices,
+                static_cast<size_t>(indicesSize));
+
+    UploadContext::Staging indexStaging = {
+        staging.buffer, staging.offset + uploadSize,
+        static_cast<uint8_t*>(staging.data) + uploadSize};
+
+    // Recorded with every other upload and submitted with the next frame
+    uploads.copyBuffer(staging, vertexGeometry.buffer, uploadSize,
+                       vertexGeometry.arena.getOffset(ret.vertices));
+    uploads.copyBuffer(indexStaging, indexGeometry.buffer, indicesSize,
+                       indexGeometry.arena.getOffset(ret.indices));
 
-    VkDeviceSize vertSize = sizeof(verts[0]) * verts.size();
-    ret.vertSize = vertSize;
+    return ret;
+}
 
-    VkDeviceSize indicesSize = sizeof(indices[0]) * indices.size();
-    VkDeviceSize bufferSize = vertSize + indicesSize;
+void VulkanAPI::destroyIndexedVertexArray(const IndexedVertexBuffer& ivb) {
+    if (ivb.vertices == GeometryArena::INVALID) return;
 
-    VkBuffer stagingBuffer;
-    VmaAllocation stagingBufferAllocation;
-    createBuffer(bufferSize, VMA_MEMORY_USAGE_CPU_ONLY,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingBuffer,
-                 stagingBufferAllocation);
+    retiredGeometry.push_back({ivb, frameNumber});
 
-    void* data;
-    vmaMapMemory(allocator, stagingBufferAllocation, &data);
-    std::memcpy(data, verts.data(), static_cast<size_t>(vertSize));
-    std::memcpy(static_cast<Vertex*>(data) + verts.size(), indices.data(),
-                static_cast<size_t>(indicesSize));
-    vmaUnmapMemory(allocator, stagingBufferAllocation);
+    // Draws of the mesh have to be rebuilt before its ranges are reused
+    drawListVersion++;
+}
 
-    createBuffer(bufferSize, VMA_MEMORY_USAGE_GPU_ONLY,
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                 ret.buffer, ret.bufferAllocation);
+void VulkanAPI::compactGeometry() {
+    relocateGeometry(vertexGeometry, vertexGeometry.arena.getCapacity());
+    relocateGeometry(indexGeometry, indexGeometry.arena.getCapacity());
+}
 
-    copyBuffer(stagingBuffer, ret.buffer, bufferSize);
+void VulkanAPI::createGeometryBuffers() {
+    ASH_INFO("Creating geometry buffers for {} byte vertices", vertexStride);
 
-    vmaDestroyBuffer(allocator, stagingBuffer, stagingBufferAllocation);
+    // Transfer source so that compaction can copy out of them
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-    indexedVertexBuffers.push_back(ret);
+    vertexGeometry.usage = usage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    vertexGeometry.name = "vertex";
+    createGeometryBuffer(vertexGeometry, VERTEX_BUFFER_SIZE);
+    vertexGeometry.arena.init(VERTEX_BUFFER_SIZE);
 
-    return ret;
+    indexGeometry.usage = usage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    indexGeometry.name = "index";
+    createGeometryBuffer(indexGeometry, INDEX_BUFFER_SIZE);
+    indexGeometry.arena.init(INDEX_BUFFER_SIZE);
+}
+
+void VulkanAPI::createGeometryBuffer(GeometryBuffer& geometry,
+                                     VkDeviceSize capacity) {
+    createBuffer(capacity, VMA_MEMORY_USAGE_GPU_ONLY, geometry.usage,
+                 geometry.buffer, geometry.allocation);
+}
+
+GeometryArena::Handle VulkanAPI::allocateGeometry(GeometryBuffer& geometry,
+                                                  VkDeviceSize size,
+                                                  VkDeviceSize alignment) {
+    GeometryArena& arena = geometry.arena;
+
+    GeometryArena::Handle handle = arena.allocate(size, alignment);
+    if (handle != GeometryArena::INVALID) return handle;
+
+    // Packing the ranges together is enough if the free space is only
+    // fragmented, otherwise the buffer doubles
+    VkDeviceSize capacity = arena.getCapacity();
+    VkDeviceSize required = arena.getCompactedSize() + size + alignment - 1;
+    while (capacity < required) capacity *= 2;
+
+    relocateGeometry(geometry, capacity);
+
+    handle = arena.allocate(size, alignment);
+    ASH_ASSERT(handle != GeometryArena::INVALID,
+               "Failed to allocate {} bytes of {} data", size, geometry.name);
+    return handle;
+}
+
+void VulkanAPI::relocateGeometry(GeometryBuffer& geometry,
+                                 VkDeviceSize capacity) {
+    VkDeviceSize previousCapacity = geometry.arena.getCapacity();
+    VkBuffer previous = geometry.buffer;
+    VmaAllocation previousAllocation = geometry.allocation;
+
+    createGeometryBuffer(geometry, capacity);
+    std::vector<VkBufferCopy> copies = geometry.arena.compact(capacity);
+
+    VkCommandBuffer commandBuffer = uploads.getCommandBuffer();
+
+    // Meshes uploaded earlier in the batch are copied again from the old
+    // buffer
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+
+    if (!copies.empty())
+        vkCmdCopyBuffer(commandBuffer, previous, geometry.buffer,
+                        static_cast<uint32_t>(copies.size()), copies.data());
+
+    // Frames in flight still draw from the old buffer
+    retireBuffer(previous, previousAllocation);
+
+    // Every draw has moved, and the recorded commands bind the old buffer
+    drawListVersion++;
+    batchListVersion++;
+
+    ASH_INFO("Compacted {} buffer in {} copies: {} bytes used, {} -> {} bytes",
+             geometry.name, copies.size(), geometry.arena.getUsed(),
+             previousCapacity, capacity);
 }
 
 /*
@@ -12,16 +12,22 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "Core.h"
+#include "Culling.h"
 #include "Helper.h"
 #include "Pipeline.h"
+#include "RenderQueue.h"
+#include "RingBuffer.h"
+#include "Scene.h"
+#include "TextureDecoder.h"
+#include "UploadContext.h"
+#include "WorkerPool.h"
 
 #define VULKAN_VERSION VK_API_VERSION_1_2
 
-#define MAX_INSTANCES 1024
-
 namespace Ash {
 
 class VulkanAPI {
@@ -35,13 +41,62 @@ class VulkanAPI {
 
     void setClearColor(const glm::vec4& color);
 
+    // Number of threads that record draw commands, 0 uses one per core.
+    // Must be called before init
+    void setRecordingThreads(uint32_t count);
+
+    // Issues draws from a per-frame indirect command buffer so that draw
+    // commands only need re-recording when the bound state changes, not when
+    // instance counts do. Must be called before init
+    void setIndirectDrawing(bool enabled);
+
+    // Skips instances outside of the camera frustum by writing only the
+    // visible ones into the indirect draws. Implies indirect drawing, must be
+    // called before init
+    void setCullingMode(CullingMode mode);
+
+    // Uploads meshes quantised into CompressedVertex, which is less than half
+    // the size of Vertex. On by default, turning it off uploads the full
+    // precision Vertex. Must be called before init
+    void setVertexCompression(bool enabled);
+
+    // Draws the built-in "main" pipeline with push constants, like user
+    // pipelines created with them. Must be called before init
+    void setMainPushConstants(bool enabled);
+
+    // Counters from the last time the draw commands were recorded and, when
+    // culling on the CPU, from the last frame
+    const RenderStats& getStats() const;
+
+    // Listens for Renderable changes so command buffers are only re-recorded
+    // when the draw list changes
+    void trackScene(Scene& scene);
+    void untrackScene(Scene& scene);
+
+    // Positions are quantised against the bounds when vertices are compressed
     IndexedVertexBuffer createIndexedVertexArray(
-        const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices);
+        const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices,
+        const Bounds& bounds);
+    // Copies the vertices and indices straight into staging memory
+    IndexedVertexBuffer createIndexedVertexArray(const void* verts,
+                                                 VkDeviceSize vertSize,
+                                                 const uint32_t* indices,
+                                                 uint32_t numIndices,
+                                                 const Bounds& bounds);
+    // The ranges are reused once the frames in flight are done with them
+    void destroyIndexedVertexArray(const IndexedVertexBuffer& ivb);
+    // Packs every mesh to the front of the vertex and index buffers, worth
+    // doing after unloading many meshes
+    void compactGeometry();
     void createDescriptorSets();
-    void createDescriptorSets(std::vector<VkDescriptorSet>& sets,
-                              const Texture& texture);
+    void createCullDescriptorSets();
     void createUniformBuffers();
     void createTextureImage(const std::string& path, Texture& texture);
+
+    // Decodes the image on a worker thread and uploads it in a batch with
+    // other textures during render. The texture keeps whatever descriptor
+    // set it has until the upload has completed
+    void loadTextureAsync(const std::string& path, Texture& texture);
     void createTextureImageView(Texture& texture);
 
    private:
@@ -60,8 +115,141 @@ class VulkanAPI {
         std::vector<VkPresentModeKHR> presentModes;
     };
 
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    struct FrameData {
+        // Reset every time the frame comes around again
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+
+        // Draw commands are cached and only re-recorded when the draw list
+        // changes. There is one secondary buffer per recording thread
+        std::vector<VkCommandPool> drawCommandPools;
+        std::vector<VkCommandBuffer> drawCommands;
+        uint32_t activeDrawCommands = 0;
+        uint64_t drawListVersion = 0;
+        uint64_t batchListVersion = 0;
+
+        // Draws using push constants are recorded here every frame, since
+        // their transforms are baked into the commands
+        VkCommandBuffer pushCommands;
+
+        // Capacities the frame's buffers and descriptor sets were created for
+        uint32_t instanceCapacity = 0;
+        uint32_t drawCapacity = 0;
+
+        // Where this frame's objects were written in the object ring, and
+        // where they were when the draw commands were recorded
+        uint32_t objectOffset = 0;
+        uint32_t recordedObjectOffset = 0;
+
+        // The frame's ring region keeps its objects between turns, so only
+        // instances that moved since need writing. Rewritten in full when the
+        // object list version changes
+        uint64_t objectListVersion = 0;
+        std::vector<uint32_t> changedObjects;
+        std::vector<uint8_t> objectChanged;
+
+        // The static object buffer the descriptor sets point at
+        VkBuffer staticObjectBuffer = VK_NULL_HANDLE;
+
+        VkBuffer cameraBuffer;
+        VmaAllocation cameraAllocation;
+        CameraData* cameraData = nullptr;
+
+        // Object index of every drawn instance
+        VkBuffer instanceBuffer;
+        VmaAllocation instanceAllocation;
+        uint32_t* instanceData = nullptr;
+
+        // Quantisation of every draw, only written when vertices are
+        // compressed
+        VkBuffer drawDataBuffer;
+        VmaAllocation drawDataAllocation;
+        DrawData* drawData = nullptr;
+
+        // Only used when drawing indirectly
+        VkBuffer indirectBuffer = VK_NULL_HANDLE;
+        VmaAllocation indirectAllocation = VK_NULL_HANDLE;
+        VkDrawIndexedIndirectCommand* indirectData = nullptr;
+
+        // Only used when culling on the GPU. The culled buffer is filled from
+        // the indirect buffer by the culling pass every frame
+        VkBuffer culledIndirectBuffer = VK_NULL_HANDLE;
+        VmaAllocation culledIndirectAllocation = VK_NULL_HANDLE;
+        VkBuffer cullBuffer = VK_NULL_HANDLE;
+        VmaAllocation cullAllocation = VK_NULL_HANDLE;
+        void* cullData = nullptr;
+        VkBuffer drawRefBuffer = VK_NULL_HANDLE;
+        VmaAllocation drawRefAllocation = VK_NULL_HANDLE;
+        void* drawRefData = nullptr;
+        VkDescriptorSet cullDescriptorSet;
+    };
+
+    // Matches CullInstance in cull.comp
+    struct CullInstance {
+        glm::vec4 sphere;
+        uint32_t firstDraw;
+        uint32_t drawCount;
+        uint32_t firstInstance;
+        uint32_t objectIndex;
+    };
+
+    // Matches the push constants of shader.vert and push.vert. The model is
+    // only pushed for pipelines drawing with push constants. The first draw
+    // is only pushed when vertices are compressed, once per batch when a
+    // batch is a single multi-draw and once per draw otherwise
+    struct DrawConstants {
+        glm::mat4 model;
+        uint32_t firstDraw;
+    };
+
+    // Matches DrawData in shader.vert, one per draw in the render queue
+    struct DrawData {
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+    };
+
+    struct CullConstants {
+        glm::vec4 planes[6];
+        uint32_t instanceCount;
+    };
+
+    struct CullGroup {
+        glm::vec4 sphere;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    // A streamed texture whose copy has been recorded
+    struct TextureUpload {
+        std::string name;
+        VkImage image;
+        VmaAllocation allocation;
+        VkFormat format;
+        uint32_t mipLevels;
+    };
+
+    // A buffer that may still be read by frames in flight
+    struct RetiredBuffer {
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        uint64_t frameNumber;
+    };
+
+    // A mesh's ranges, which may still be drawn by frames in flight
+    struct RetiredGeometry {
+        IndexedVertexBuffer ivb;
+        uint64_t frameNumber;
+    };
+
+    // One of the shared geometry buffers and the ranges allocated from it
+    struct GeometryBuffer {
+        GeometryArena arena;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkBufferUsageFlags usage = 0;
+        const char* name = "";
+    };
+
     bool checkValidationSupport();
     void createInstance();
     void setupDebugMessenger();
@@ -75,38 +263,89 @@ class VulkanAPI {
     void createDescriptorSetLayout();
     void createPipelineCache();
     void createGraphicsPipelines(const std::vector<Pipeline>& pipelines);
+    void createCullPipeline();
     void createFramebuffers();
     void createDescriptorPool(uint32_t maxSets);
     void createCommandPools();
     void createCommandBuffers();
-    void recordCommandBuffers();
+    void createObjectRing();
+    void createStaticObjects();
+    void createGeometryBuffers();
+    void createGeometryBuffer(GeometryBuffer& geometry, VkDeviceSize capacity);
+    GeometryArena::Handle allocateGeometry(GeometryBuffer& geometry,
+                                           VkDeviceSize size,
+                                           VkDeviceSize alignment);
+    // Moves every range to the front of a new buffer of the given capacity
+    void relocateGeometry(GeometryBuffer& geometry, VkDeviceSize capacity);
+    void classifyInstances(entt::registry& registry);
+    void setCullSphere(uint32_t instance, const glm::mat4& model);
+    void createDrawBuffers(size_t frameIndex);
+    void destroyDrawBuffers(size_t frameIndex);
+    void writeDescriptorSets(size_t frameIndex);
+    void writeCullDescriptorSet(size_t frameIndex);
+    void reserveInstances(size_t frameIndex);
+    void retireBuffer(VkBuffer buffer, VmaAllocation allocation);
+    void destroyRetiredBuffers();
+    void writeIndirectCommands(size_t frameIndex);
+    void writeInstanceIndices(size_t frameIndex);
+    void writeDrawData(size_t frameIndex);
+    void writeCullData(size_t frameIndex);
+    void buildCullData();
+    void recordCulling(VkCommandBuffer commandBuffer);
+    void writeVisibleInstances(size_t frameIndex);
+    void recordCommandBuffer(uint32_t imageIndex);
+    void buildRenderQueue();
+    void recordDrawCommands(size_t frameIndex);
+    RenderStats recordDrawRange(size_t frameIndex, size_t thread,
+                                size_t begin, size_t end);
+    void recordPushConstantDraws(size_t frameIndex);
+    void beginDrawCommands(VkCommandBuffer commandBuffer, size_t frameIndex,
+                           RenderStats& recordStats);
     void createSyncObjects();
     void cleanupSwapchain();
     void recreateSwapchain();
-    void updateCommandBuffers();
+    void onDrawListChanged(entt::registry& registry, entt::entity entity);
+    void onTransformChanged(entt::registry& registry, entt::entity entity);
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
                                  VkImageTiling tiling,
                                  VkFormatFeatureFlags features);
     bool hasStencilComponent(VkFormat format);
     VkFormat findDepthFormat();
     void createDepthResources();
+    // Passing mapped keeps the allocation persistently mapped
     void createBuffer(VkDeviceSize size, VmaMemoryUsage memUsage,
                       VkBufferUsageFlags usage, VkBuffer& buffer,
-                      VmaAllocation& allocation);
+                      VmaAllocation& allocation, void** mapped = nullptr);
     void createImage(uint32_t width, uint32_t height, VmaMemoryUsage memUsage,
                      VkFormat format, VkImageTiling tiling,
                      VkImageUsageFlags usage, VkImage& image,
-                     VmaAllocation& allocation);
+                     VmaAllocation& allocation, uint32_t mipLevels = 1);
     VkImageView createImageView(VkImage image, VkFormat format,
-                                VkImageAspectFlags aspectFlags);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                           uint32_t height);
+                                VkImageAspectFlags aspectFlags,
+                                uint32_t mipLevels = 1);
     void updateUniformBuffers(uint32_t currentImage);
     void createTextureSampler();
+    void createTextureDescriptorSet(Texture& texture);
     void transitionImageLayout(VkImage image, VkFormat format,
-                               VkImageLayout oldLayout,
-                               VkImageLayout newLayout);
+                               VkImageLayout oldLayout, VkImageLayout newLayout,
+                               uint32_t mipLevels = 1);
+    void recordImageTransition(VkCommandBuffer commandBuffer, VkImage image,
+                               VkFormat format, VkImageLayout oldLayout,
+                               VkImageLayout newLayout,
+                               uint32_t baseMipLevel = 0,
+                               uint32_t levelCount = 1);
+    // Records the upload of an RGBA8 image with its full mip chain and
+    // returns the number of levels
+    uint32_t recordTextureUpload(const uint8_t* pixels, uint32_t width,
+                                 uint32_t height, VkImage& image,
+                                 VmaAllocation& allocation);
+    void recordMipmapBlits(VkImage image, uint32_t width, uint32_t height,
+                           uint32_t mipLevels);
+    // Records the upload of every level of a block compressed image
+    uint32_t recordCompressedUpload(const Ktx::Image& ktx, VkImage& image,
+                                    VmaAllocation& allocation);
+    void streamTextures();
+    void finishTextureUploads();
 
     SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device);
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -129,6 +368,7 @@ class VulkanAPI {
     VkDebugUtilsMessengerEXT debugMessenger;
 
     VkPhysicalDevice physicalDevice;
+    VkPhysicalDeviceProperties deviceProperties;
     VkDevice device;
 
     VkQueue graphicsQueue;
@@ -154,32 +394,108 @@ class VulkanAPI {
     VkDescriptorSetLayout imageDescriptorSetLayout;
     VkPipelineLayout pipelineLayout;
 
+    VkDescriptorSetLayout cullDescriptorSetLayout;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
+
     VkDescriptorPool descriptorPool;
 
     VkPipelineCache pipelineCache;
     std::unordered_map<std::string, VkPipeline> graphicsPipelines;
+    std::unordered_map<std::string, uint32_t> pipelineIndices;
+    std::unordered_set<std::string> pushConstantPipelines;
     std::vector<Pipeline> pipelineObjects;
 
     VkSampler textureSampler;
 
-    VkCommandPool commandPool;
-    VkCommandPool transferCommandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<FrameData> frames;
+    uint64_t drawListVersion = 1;
+    uint64_t frameNumber = 0;
+
+    // Grown geometrically when the render queue outgrows them
+    uint32_t instanceCapacity = INITIAL_CAPACITY;
+    uint32_t drawCapacity = INITIAL_CAPACITY;
+    std::vector<RetiredBuffer> retiredBuffers;
+
+    RenderQueue renderQueue;
+    uint64_t renderQueueVersion = 0;
+    uint64_t batchListVersion = 1;
+
+    std::vector<CullGroup> cullGroups;
+    std::vector<CullInstance> cullInstances;
+    std::vector<uint32_t> cullDrawRefs;
+    glm::mat4 viewProjection{1.0f};
+
+    // Model matrices of the instances drawn with push constants, indexed by
+    // instance. These have no object in the ring or the static buffer
+    uint32_t pushConstantInstances = 0;
+    std::vector<glm::mat4> instanceModels;
+    std::unordered_map<entt::entity, uint32_t> pushObjects;
+
+    // Object index of every instance. Dynamic objects are written to the ring
+    // every frame, static ones only when the set of static entities changes
+    std::vector<uint32_t> objectIndices;
+    std::vector<uint32_t> dynamicInstances;
+    std::vector<entt::entity> staticEntities;
+
+    // Instance of every dynamic entity, and entities whose world transform
+    // changed since the last frame
+    std::unordered_map<entt::entity, uint32_t> dynamicObjects;
+    std::vector<entt::entity> changedEntities;
+    uint64_t objectListVersion = 1;
+    VkBuffer staticObjectBuffer = VK_NULL_HANDLE;
+    VmaAllocation staticObjectAllocation = VK_NULL_HANDLE;
+
+    FrustumCuller culler;
+    std::vector<uint32_t> visibleInstances;
+    std::vector<uint32_t> visibleCounts;
+    RenderStats stats;
+
+    uint32_t recordingThreads = 1;
+    bool indirectDrawing = false;
+    bool multiDrawIndirect = false;
+    // Without shaderDrawParameters the main vertex shader is swapped for a
+    // variant that doesn't use gl_DrawIDARB
+    bool drawParameters = true;
+    // Whether mip chains can be generated with linear blits on the GPU
+    bool blitMipmaps = false;
+    bool textureCompressionBC = false;
+    bool vertexCompression = true;
+    bool mainPushConstants = false;
+    // Size of the vertices in the geometry buffer
+    uint32_t vertexStride = sizeof(CompressedVertex);
+    CullingMode cullingMode = CullingMode::None;
 
     std::vector<VkDescriptorSet> uboDescriptorSets;
-    std::vector<UniformBuffer> uniformBuffers;
+    RingBuffer objectRing;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
     std::vector<VkFence> imagesInFlight;
-    VkFence copyFinishedFence;
 
     VmaAllocator allocator;
 
+    UploadContext uploads;
+
+    // Textures are decoded off the main thread and uploaded in batches, one
+    // of which is in flight at a time
+    TextureDecoder textureDecoder;
+    std::vector<TextureDecoder::Image> decodedTextures;
+    std::vector<TextureUpload> textureUploads;
+    uint64_t textureBatch = 0;
+
+    // Records the cached draw commands, each thread into its own pool
+    WorkerPool recordingPool;
+
+    // Every mesh is a range of these, so they are bound once per command
+    // buffer no matter how many meshes are drawn
+    GeometryBuffer vertexGeometry;
+    GeometryBuffer indexGeometry;
+    std::vector<RetiredGeometry> retiredGeometry;
+
     // Keeps track of all allocations in order to be freed
     // at end of runtime
-    std::vector<IndexedVertexBuffer> indexedVertexBuffers;
     std::vector<Texture> textures;
 
     size_t currentFrame = 0;
@@ -192,8 +508,30 @@ class VulkanAPI {
     const std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+    static constexpr uint32_t INITIAL_CAPACITY = 1024;
+
+    // Set in object indices that refer to the static object buffer
+    static constexpr uint32_t STATIC_OBJECT = 0x80000000u;
+
     const size_t MAX_FRAMES_IN_FLIGHT = 2;
 
+    const uint32_t MAX_TEXTURES = 1024;
+
+    const size_t MIN_DRAWS_PER_THREAD = 256;
+
+    const uint32_t CULL_GROUP_SIZE = 64;
+
+    // Pixels streamed in per batch, a larger texture gets a batch of its own.
+    // Well below the staging ring's size so streaming never has to wait for
+    // space
+    const VkDeviceSize TEXTURE_UPLOAD_BUDGET = 16 * 1024 * 1024;
+
+    const VkDeviceSize STAGING_SIZE = 64 * 1024 * 1024;
+
+    // Starting sizes of the geometry buffers, which double when full
+    const VkDeviceSize VERTEX_BUFFER_SIZE = 32 * 1024 * 1024;
+    const VkDeviceSize INDEX_BUFFER_SIZE = 16 * 1024 * 1024;
+
 #ifndef ASH_DEBUG
     const bool enableValidationLayers = false;
 #else
@@ -0,0 +1,78 @@
+#include "WorkerPool.h"
+
+#include "Core.h"
+#include "Log.h"
+
+namespace Ash {
+
+WorkerPool::~WorkerPool() { stop(); }
+
+void WorkerPool::start(uint32_t threads) {
+    stopping = false;
+    for (uint32_t i = 0; i < threads; i++)
+        workers.emplace_back(&WorkerPool::work, this, i + 1);
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+}
+
+void WorkerPool::run(uint32_t count,
+                     const std::function<void(uint32_t)>& job) {
+    ASH_ASSERT(count <= getMaxParts(), "Worker pool can't run {} parts",
+               count);
+    if (count == 0) return;
+
+    if (count > 1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->job = &job;
+            parts = count;
+            remaining = count - 1;
+            generation++;
+        }
+        started.notify_all();
+    }
+
+    job(0);
+
+    if (count > 1) {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return remaining == 0; });
+        this->job = nullptr;
+    }
+}
+
+void WorkerPool::work(uint32_t part) {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(uint32_t)>* current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock,
+                         [&] { return stopping || generation != seen; });
+            if (stopping) return;
+
+            seen = generation;
+            if (part >= parts) continue;
+            current = job;
+        }
+
+        (*current)(part);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining--;
+        }
+        finished.notify_one();
+    }
+}
+
+}  // namespace Ash
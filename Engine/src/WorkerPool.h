@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ash {
+
+// Threads that live as long as the pool and run one job split into parts,
+// so work spread over them every frame doesn't create threads. Part 0 runs
+// on the calling thread and part i on worker i - 1, which lets each part own
+// per-thread resources like command pools
+class WorkerPool {
+   public:
+    ~WorkerPool();
+
+    // Parts beyond threads + 1 can't be run
+    void start(uint32_t threads);
+    void stop();
+
+    // Calls job with every part below count and returns once all of them
+    // are done
+    void run(uint32_t count, const std::function<void(uint32_t)>& job);
+
+    uint32_t getMaxParts() const {
+        return static_cast<uint32_t>(workers.size()) + 1;
+    }
+
+   private:
+    void work(uint32_t part);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(uint32_t)>* job = nullptr;
+    uint32_t parts = 0;
+    uint32_t remaining = 0;
+    // Counts runs, so that workers notice a new one
+    uint64_t generation = 0;
+    bool stopping = false;
+};
+
+}  // namespace Ash
@@ -29,7 +29,7 @@ void GameLayer::init() {
     scene = std::make_shared<Scene>();
 
     Renderer::loadMesh("Quad", vertices, indices);
-    Renderer::loadTexture("statue", "assets/textures/texture.jpg");
+    Renderer::loadTextureAsync("statue", "assets/textures/texture.jpg");
 
     std::vector<std::string> meshes = {"Quad"};
     std::vector<std::string> textures = {"statue"};
@@ -0,0 +1,54 @@
+// Destroys a parent without a Renderable right after it moved. Its transform
+// change is still queued for the renderer when the next frame is drawn, which
+// trips EnTT's assert in debug builds if the dead entity is looked up
+
+#include <Ash.h>
+#include <Components.h>
+
+using namespace Ash;
+
+namespace {
+
+const std::vector<Vertex> vertices = {{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f}},
+                                      {{0.5f, -0.5f, 0.0f}, {0.0f, 0.0f}},
+                                      {{0.5f, 0.5f, 0.0f}, {0.0f, 1.0f}},
+                                      {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f}}};
+
+const std::vector<uint32_t> indices = {0, 1, 2, 2, 3, 0};
+
+void renderFrame() {
+    Renderer::render();
+    App::getWindow()->pollEvents();
+}
+
+}  // namespace
+
+int main() {
+    App::init();
+
+    Renderer::loadMesh("Quad", vertices, indices);
+    Renderer::loadModel("Quad", {"Quad"}, {"white"});
+
+    std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+
+    Entity parent = scene->spawn();
+    scene->addComponent<Transform>(parent, glm::vec3{0.0f, 0.0f, 0.0f});
+
+    Entity child = scene->spawn();
+    scene->addComponent<Renderable>(child, "Quad", "main");
+    scene->addComponent<Transform>(child, glm::vec3{0.5f, 0.0f, 0.0f});
+    scene->setParent(child, parent);
+
+    App::setScene(scene);
+    renderFrame();
+
+    scene->registry.get<Transform>(parent.getHandle()).position.x = 1.0f;
+    renderFrame();
+
+    scene->destroyEntity(parent);
+    renderFrame();
+    renderFrame();
+
+    App::cleanup();
+    return 0;
+}
@@ -0,0 +1,768 @@
+// Times three ways of giving every draw its model matrix: push constants, as
+// pipelines created with them do, a uniform buffer rebound at a dynamic
+// offset per draw, and one storage buffer indexed by the instance, like the
+// object ring. Each frame writes the matrices, records the draws and waits
+// for the GPU. Renders offscreen, so it needs no window
+//
+// Usage: ashbench_draws [draws]
+
+#include <Helper.h>
+#include <Log.h>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace Ash;
+
+namespace {
+
+const uint32_t SIZE = 256;
+const VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+const uint32_t WARMUP_FRAMES = 10;
+const uint32_t FRAMES = 100;
+
+enum class Path { PushConstants, Uniform, Storage };
+
+const std::array<Path, 3> PATHS = {Path::PushConstants, Path::Uniform,
+                                   Path::Storage};
+
+const char* pathName(Path path) {
+    switch (path) {
+        case Path::PushConstants:
+            return "push constants";
+        case Path::Uniform:
+            return "uniform buffer";
+        default:
+            return "storage buffer";
+    }
+}
+
+const char* shaderPath(Path path) {
+    switch (path) {
+        case Path::PushConstants:
+            return "assets/shaders/bench_push.vert.spv";
+        case Path::Uniform:
+            return "assets/shaders/bench_uniform.vert.spv";
+        default:
+            return "assets/shaders/bench_storage.vert.spv";
+    }
+}
+
+void check(VkResult result, const char* what) {
+    if (result == VK_SUCCESS) return;
+    APP_ERROR("Failed to {} ({})", what, static_cast<int>(result));
+    std::exit(1);
+}
+
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    void* data = nullptr;
+};
+
+struct PathResources {
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+struct Timings {
+    double write = 0.0;
+    double record = 0.0;
+    double gpu = 0.0;
+};
+
+class Bench {
+   public:
+    explicit Bench(uint32_t draws) : draws(draws) {}
+
+    void init() {
+        createDevice();
+        createTarget();
+        createBuffers();
+        createPaths();
+        createCommands();
+    }
+
+    Timings run(Path path) {
+        Timings total{};
+        for (uint32_t frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++) {
+            Timings timings = runFrame(path, frame);
+            if (frame < WARMUP_FRAMES) continue;
+
+            total.write += timings.write;
+            total.record += timings.record;
+            total.gpu += timings.gpu;
+        }
+
+        total.write /= FRAMES;
+        total.record /= FRAMES;
+        total.gpu /= FRAMES;
+        return total;
+    }
+
+    void cleanup() {
+        vkDeviceWaitIdle(device);
+
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+
+        for (PathResources& resources : paths) {
+            vkDestroyPipeline(device, resources.pipeline, nullptr);
+            vkDestroyPipelineLayout(device, resources.layout, nullptr);
+            if (resources.setLayout)
+                vkDestroyDescriptorSetLayout(device, resources.setLayout,
+                                             nullptr);
+        }
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+
+        for (Buffer* buffer :
+             {&vertexBuffer, &indexBuffer, &uniformBuffer, &storageBuffer})
+            vmaDestroyBuffer(allocator, buffer->buffer, buffer->allocation);
+
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyImageView(device, imageView, nullptr);
+        vmaDestroyImage(allocator, image, imageAllocation);
+
+        vmaDestroyAllocator(allocator);
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+
+    const char* deviceName() const { return deviceProperties.deviceName; }
+
+   private:
+    void createDevice() {
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "ashbench_draws";
+        appInfo.apiVersion = VK_API_VERSION_1_2;
+
+        VkInstanceCreateInfo instanceInfo{};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+        check(vkCreateInstance(&instanceInfo, nullptr, &instance),
+              "create instance");
+
+        uint32_t count = 0;
+        vkEnumeratePhysicalDevices(instance, &count, nullptr);
+        std::vector<VkPhysicalDevice> devices(count);
+        vkEnumeratePhysicalDevices(instance, &count, devices.data());
+
+        // Prefer a discrete GPU, any device with a graphics queue will do
+        for (VkPhysicalDevice candidate : devices) {
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount,
+                                                     nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount,
+                                                     families.data());
+
+            for (uint32_t i = 0; i < familyCount; i++) {
+                if (!(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+                    continue;
+
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(candidate, &properties);
+                if (physicalDevice == VK_NULL_HANDLE ||
+                    properties.deviceType ==
+                        VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+                    physicalDevice = candidate;
+                    queueFamily = i;
+                    timestampBits = families[i].timestampValidBits;
+                }
+                break;
+            }
+        }
+
+        if (physicalDevice == VK_NULL_HANDLE) {
+            APP_ERROR("No device with a graphics queue");
+            std::exit(1);
+        }
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+
+        VkDeviceCreateInfo deviceInfo{};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device),
+              "create device");
+        vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+        VmaAllocatorCreateInfo allocatorInfo{};
+        allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_2;
+        allocatorInfo.physicalDevice = physicalDevice;
+        allocatorInfo.device = device;
+        allocatorInfo.instance = instance;
+        check(vmaCreateAllocator(&allocatorInfo, &allocator),
+              "create allocator");
+    }
+
+    void createTarget() {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = FORMAT;
+        imageInfo.extent = {SIZE, SIZE, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo allocationInfo{};
+        allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        check(vmaCreateImage(allocator, &imageInfo, &allocationInfo, &image,
+                             &imageAllocation, nullptr),
+              "create render target");
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FORMAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        check(vkCreateImageView(device, &viewInfo, nullptr, &imageView),
+              "create render target view");
+
+        VkAttachmentDescription attachment{};
+        attachment.format = FORMAT;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorReference{
+            0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &attachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        check(vkCreateRenderPass(device, &renderPassInfo, nullptr,
+                                 &renderPass),
+              "create render pass");
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &imageView;
+        framebufferInfo.width = SIZE;
+        framebufferInfo.height = SIZE;
+        framebufferInfo.layers = 1;
+        check(vkCreateFramebuffer(device, &framebufferInfo, nullptr,
+                                  &framebuffer),
+              "create framebuffer");
+    }
+
+    Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        // Written by the host every frame, like the object ring
+        VmaAllocationCreateInfo allocationInfo{};
+        allocationInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        allocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        Buffer buffer;
+        VmaAllocationInfo info{};
+        check(vmaCreateBuffer(allocator, &bufferInfo, &allocationInfo,
+                              &buffer.buffer, &buffer.allocation, &info),
+              "create buffer");
+        buffer.data = info.pMappedData;
+        return buffer;
+    }
+
+    void createBuffers() {
+        const std::array<glm::vec3, 4> vertices = {
+            glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(0.5f, -0.5f, 0.0f),
+            glm::vec3(0.5f, 0.5f, 0.0f), glm::vec3(-0.5f, 0.5f, 0.0f)};
+        const std::array<uint32_t, 6> indices = {0, 1, 2, 2, 3, 0};
+
+        vertexBuffer =
+            createBuffer(sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        std::memcpy(vertexBuffer.data, vertices.data(), sizeof(vertices));
+        indexBuffer =
+            createBuffer(sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        std::memcpy(indexBuffer.data, indices.data(), sizeof(indices));
+        vmaFlushAllocation(allocator, vertexBuffer.allocation, 0,
+                           VK_WHOLE_SIZE);
+        vmaFlushAllocation(allocator, indexBuffer.allocation, 0,
+                           VK_WHOLE_SIZE);
+
+        // Dynamic offsets must be aligned, so every matrix gets a full slot
+        VkDeviceSize alignment =
+            deviceProperties.limits.minUniformBufferOffsetAlignment;
+        uniformStride =
+            (sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+        uniformBuffer = createBuffer(uniformStride * draws,
+                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        storageBuffer = createBuffer(sizeof(glm::mat4) * draws,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        // Small quads scattered over the target, spun a little every frame
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+        positions.resize(draws);
+        for (glm::vec3& p : positions)
+            p = glm::vec3(position(rng), position(rng), 0.5f);
+        models.resize(draws);
+    }
+
+    void createPaths() {
+        std::array<VkDescriptorPoolSize, 2> poolSizes = {
+            VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+            VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 2;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        check(vkCreateDescriptorPool(device, &poolInfo, nullptr,
+                                     &descriptorPool),
+              "create descriptor pool");
+
+        std::vector<char> fragCode =
+            Helper::readBinaryFile("assets/shaders/bench.frag.spv");
+        VkShaderModule frag = createShaderModule(fragCode);
+
+        for (Path path : PATHS) {
+            PathResources& resources = paths[static_cast<size_t>(path)];
+
+            VkPipelineLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+            VkPushConstantRange pushConstantRange{
+                VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4)};
+            if (path == Path::PushConstants) {
+                layoutInfo.pushConstantRangeCount = 1;
+                layoutInfo.pPushConstantRanges = &pushConstantRange;
+            } else {
+                createObjectSet(path, resources);
+                layoutInfo.setLayoutCount = 1;
+                layoutInfo.pSetLayouts = &resources.setLayout;
+            }
+
+            check(vkCreatePipelineLayout(device, &layoutInfo, nullptr,
+                                         &resources.layout),
+                  "create pipeline layout");
+
+            std::vector<char> vertCode = Helper::readBinaryFile(
+                shaderPath(path));
+            VkShaderModule vert = createShaderModule(vertCode);
+            createPipeline(vert, frag, resources);
+            vkDestroyShaderModule(device, vert, nullptr);
+        }
+
+        vkDestroyShaderModule(device, frag, nullptr);
+    }
+
+    void createObjectSet(Path path, PathResources& resources) {
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = 0;
+        binding.descriptorType = path == Path::Uniform
+                                     ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                                     : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+        setLayoutInfo.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = 1;
+        setLayoutInfo.pBindings = &binding;
+        check(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr,
+                                          &resources.setLayout),
+              "create descriptor set layout");
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &resources.setLayout;
+        check(vkAllocateDescriptorSets(device, &allocInfo, &resources.set),
+              "allocate descriptor set");
+
+        // The uniform path sees one matrix at a time, moved by the offset
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = path == Path::Uniform ? uniformBuffer.buffer
+                                                  : storageBuffer.buffer;
+        bufferInfo.range =
+            path == Path::Uniform ? sizeof(glm::mat4) : VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = resources.set;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = binding.descriptorType;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    VkShaderModule createShaderModule(const std::vector<char>& code) {
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        VkShaderModule module;
+        check(vkCreateShaderModule(device, &createInfo, nullptr, &module),
+              "create shader module");
+        return module;
+    }
+
+    void createPipeline(VkShaderModule vert, VkShaderModule frag,
+                        PathResources& resources) {
+        std::array<VkPipelineShaderStageCreateInfo, 2> stages{};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vert;
+        stages[0].pName = "main";
+        stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = frag;
+        stages[1].pName = "main";
+
+        VkVertexInputBindingDescription binding{0, sizeof(glm::vec3),
+                                                VK_VERTEX_INPUT_RATE_VERTEX};
+        VkVertexInputAttributeDescription attribute{
+            0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+
+        VkPipelineVertexInputStateCreateInfo vertexInput{};
+        vertexInput.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInput.vertexBindingDescriptionCount = 1;
+        vertexInput.pVertexBindingDescriptions = &binding;
+        vertexInput.vertexAttributeDescriptionCount = 1;
+        vertexInput.pVertexAttributeDescriptions = &attribute;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkViewport viewport{0.0f, 0.0f, float(SIZE), float(SIZE),
+                            0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, {SIZE, SIZE}};
+
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.lineWidth = 1.0f;
+
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState blendAttachment{};
+        blendAttachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &blendAttachment;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+        pipelineInfo.pStages = stages.data();
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.layout = resources.layout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = 0;
+
+        check(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
+                                        &pipelineInfo, nullptr,
+                                        &resources.pipeline),
+              "create pipeline");
+    }
+
+    void createCommands() {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamily;
+        check(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool),
+              "create command pool");
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        check(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer),
+              "allocate command buffer");
+
+        VkQueryPoolCreateInfo queryInfo{};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        check(vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool),
+              "create query pool");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        check(vkCreateFence(device, &fenceInfo, nullptr, &fence),
+              "create fence");
+    }
+
+    // Matrices for this frame, in the layout the path reads them from
+    void writeModels(Path path, uint32_t frame) {
+        float angle = frame * 0.01f;
+        for (uint32_t i = 0; i < draws; i++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+            model = glm::rotate(model, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+            model = glm::scale(model, glm::vec3(0.02f));
+
+            switch (path) {
+                case Path::PushConstants:
+                    models[i] = model;
+                    break;
+                case Path::Uniform:
+                    std::memcpy(static_cast<char*>(uniformBuffer.data) +
+                                    i * uniformStride,
+                                &model, sizeof(model));
+                    break;
+                case Path::Storage:
+                    static_cast<glm::mat4*>(storageBuffer.data)[i] = model;
+                    break;
+            }
+        }
+
+        if (path == Path::Uniform)
+            vmaFlushAllocation(allocator, uniformBuffer.allocation, 0,
+                               VK_WHOLE_SIZE);
+        if (path == Path::Storage)
+            vmaFlushAllocation(allocator, storageBuffer.allocation, 0,
+                               VK_WHOLE_SIZE);
+    }
+
+    void recordDraws(Path path) {
+        const PathResources& resources = paths[static_cast<size_t>(path)];
+
+        VkDeviceSize offset = 0;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          resources.pipeline);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer,
+                               &offset);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0,
+                             VK_INDEX_TYPE_UINT32);
+
+        switch (path) {
+            case Path::PushConstants:
+                for (uint32_t i = 0; i < draws; i++) {
+                    vkCmdPushConstants(commandBuffer, resources.layout,
+                                       VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                       sizeof(glm::mat4), &models[i]);
+                    vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 0, 0);
+                }
+                break;
+            case Path::Uniform:
+                for (uint32_t i = 0; i < draws; i++) {
+                    uint32_t dynamicOffset =
+                        static_cast<uint32_t>(i * uniformStride);
+                    vkCmdBindDescriptorSets(
+                        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        resources.layout, 0, 1, &resources.set, 1,
+                        &dynamicOffset);
+                    vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 0, 0);
+                }
+                break;
+            case Path::Storage:
+                // Bound once, each draw picks its matrix with firstInstance
+                vkCmdBindDescriptorSets(
+                    commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    resources.layout, 0, 1, &resources.set, 0, nullptr);
+                for (uint32_t i = 0; i < draws; i++)
+                    vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 0, i);
+                break;
+        }
+    }
+
+    Timings runFrame(Path path, uint32_t frame) {
+        Timings timings{};
+
+        auto start = std::chrono::high_resolution_clock::now();
+        writeModels(path, frame);
+        auto written = std::chrono::high_resolution_clock::now();
+
+        vkResetCommandPool(device, commandPool, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        check(vkBeginCommandBuffer(commandBuffer, &beginInfo),
+              "begin command buffer");
+
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+
+        VkClearValue clearValue{};
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea = {{0, 0}, {SIZE, SIZE}};
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            queryPool, 0);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                             VK_SUBPASS_CONTENTS_INLINE);
+        recordDraws(path);
+        vkCmdEndRenderPass(commandBuffer);
+        vkCmdWriteTimestamp(commandBuffer,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool,
+                            1);
+
+        check(vkEndCommandBuffer(commandBuffer), "end command buffer");
+        auto recorded = std::chrono::high_resolution_clock::now();
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        check(vkQueueSubmit(queue, 1, &submitInfo, fence), "submit");
+        check(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX),
+              "wait for fence");
+        vkResetFences(device, 1, &fence);
+
+        timings.write =
+            std::chrono::duration<double, std::milli>(written - start).count();
+        timings.record =
+            std::chrono::duration<double, std::milli>(recorded - written)
+                .count();
+
+        // Queues without valid timestamp bits leave the GPU time at zero
+        if (timestampBits > 0) {
+            std::array<uint64_t, 2> timestamps{};
+            check(vkGetQueryPoolResults(
+                      device, queryPool, 0, 2, sizeof(timestamps),
+                      timestamps.data(), sizeof(uint64_t),
+                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT),
+                  "read timestamps");
+            timings.gpu = (timestamps[1] - timestamps[0]) *
+                          deviceProperties.limits.timestampPeriod * 1e-6;
+        }
+
+        return timings;
+    }
+
+    uint32_t draws;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties deviceProperties{};
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    uint32_t timestampBits = 0;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation imageAllocation = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    Buffer uniformBuffer;
+    Buffer storageBuffer;
+    VkDeviceSize uniformStride = 0;
+
+    std::vector<glm::vec3> positions;
+    // Kept on the host for the push constant path
+    std::vector<glm::mat4> models;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::array<PathResources, 3> paths;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Log::init();
+
+    uint32_t draws = 10'000;
+    if (argc == 2) draws = static_cast<uint32_t>(std::atoi(argv[1]));
+    if (argc > 2 || draws == 0) {
+        APP_ERROR("Usage: ashbench_draws [draws]");
+        return 1;
+    }
+
+    Bench bench(draws);
+    bench.init();
+    APP_INFO("{} draws per frame on {}, averaged over {} frames", draws,
+             bench.deviceName(), FRAMES);
+
+    for (Path path : PATHS) {
+        Timings timings = bench.run(path);
+        APP_INFO("{:>14}: write {:7.3f} ms, record {:7.3f} ms, GPU {:7.3f} ms",
+                 pathName(path), timings.write, timings.record, timings.gpu);
+    }
+
+    bench.cleanup();
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Times the engine's CPU frustum culling and transform composition on
+// synthetic data. Built once per SIMD width as ashbench_scalar, ashbench_sse
+// and ashbench_avx, since the width is chosen when the engine is compiled
+//
+// Usage: ashbench_scalar|ashbench_sse|ashbench_avx
+
+#include <Components.h>
+#include <Culling.h>
+#include <Log.h>
+#include <Simd.h>
+#include <TransformBatch.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Ash;
+
+namespace {
+
+// Every case runs at least this many times and about this many entities in
+// total, the fastest run is reported
+const int MIN_RUNS = 5;
+const size_t WORK_PER_CASE = 20'000'000;
+
+const char* simdName() {
+    switch (ASH_SIMD_WIDTH) {
+        case 8:
+            return "AVX";
+        case 4:
+            return "SSE";
+        default:
+            return "scalar";
+    }
+}
+
+template <typename F>
+double fastestMilliseconds(size_t count, F&& run) {
+    int runs =
+        std::max<int>(MIN_RUNS, static_cast<int>(WORK_PER_CASE / count));
+
+    double fastest = 0.0;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        run();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double ms =
+            std::chrono::duration<double, std::milli>(end - start).count();
+        if (i == 0 || ms < fastest) fastest = ms;
+    }
+    return fastest;
+}
+
+// Spheres scattered through a cube around a camera at its centre, so about
+// one in twenty is visible
+void benchCulling(std::mt19937& rng) {
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+                                 glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj =
+        glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    Frustum frustum(proj * view);
+
+    for (size_t count : {10'000, 100'000, 1'000'000}) {
+        FrustumCuller culler;
+        culler.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 center(position(rng), position(rng), position(rng));
+            culler.set(i, center, radius(rng));
+        }
+
+        std::vector<uint32_t> visible;
+        visible.reserve(count);
+        double ms = fastestMilliseconds(count, [&] {
+            visible.clear();
+            culler.cull(frustum, visible);
+        });
+
+        APP_INFO("Culled {:>7} spheres, {:>6} visible, in {:8.3f} ms: "
+                 "{:>8.0f} per ms",
+                 count, visible.size(), ms, count / ms);
+    }
+}
+
+// Random local transforms composed one at a time with getTransform, as
+// TransformSystem does with batching off, and through a TransformBatch. The
+// batch is refilled every run like it is every update
+void benchTransforms(std::mt19937& rng) {
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-6.3f, 6.3f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+    for (size_t count : {10'000, 100'000, 1'000'000}) {
+        std::vector<Transform> transforms;
+        transforms.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            Transform& transform = transforms.emplace_back(
+                glm::vec3(position(rng), position(rng), position(rng)));
+            transform.rotation = glm::vec3(angle(rng), angle(rng), angle(rng));
+            transform.scale = glm::vec3(scale(rng), scale(rng), scale(rng));
+        }
+
+        std::vector<glm::mat4> scalar(count);
+        double scalarMs = fastestMilliseconds(count, [&] {
+            for (size_t i = 0; i < count; i++)
+                scalar[i] = transforms[i].getTransform();
+        });
+
+        std::vector<glm::mat4> batched(count);
+        TransformBatch batch;
+        double batchMs = fastestMilliseconds(count, [&] {
+            batch.clear();
+            for (size_t i = 0; i < count; i++) {
+                const Transform& transform = transforms[i];
+                batch.push(transform.position, transform.rotation,
+                           transform.scale, &batched[i]);
+            }
+            batch.compose();
+        });
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            for (int c = 0; c < 4; c++) {
+                for (int r = 0; r < 4; r++) {
+                    maxError = std::max(
+                        maxError, std::abs(scalar[i][c][r] - batched[i][c][r]));
+                }
+            }
+        }
+
+        APP_INFO("Composed {:>7} matrices: getTransform {:>9.0f} per s, batch "
+                 "{:>9.0f} per s, {:.1f}x, max error {:.1e}",
+                 count, count / scalarMs * 1000.0, count / batchMs * 1000.0,
+                 scalarMs / batchMs, maxError);
+    }
+}
+
+}  // namespace
+
+int main() {
+    Log::init();
+    APP_INFO("ashbench, {} paths", simdName());
+
+    std::mt19937 rng(1);
+    benchCulling(rng);
+    benchTransforms(rng);
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout (push_constant) uniform DrawConstants {
+    mat4 model;
+} constants;
+
+layout (location = 0) in vec3 inPosition;
+
+void main() {
+    gl_Position = constants.model * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 450
+
+// Every draw's matrix, picked with the draw's first instance
+layout (std430, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    mat4 models[];
+};
+
+layout (location = 0) in vec3 inPosition;
+
+void main() {
+    gl_Position = models[gl_InstanceIndex] * vec4(inPosition, 1.0);
+}
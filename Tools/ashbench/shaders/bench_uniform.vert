@@ -0,0 +1,12 @@
+#version 450
+
+// Moved to the draw's matrix with a dynamic offset
+layout (set = 0, binding = 0) uniform ObjectBuffer {
+    mat4 model;
+} object;
+
+layout (location = 0) in vec3 inPosition;
+
+void main() {
+    gl_Position = object.model * vec4(inPosition, 1.0);
+}
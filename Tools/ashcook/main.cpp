@@ -0,0 +1,193 @@
+// Cooks every asset under the given directories into one archive that the
+// engine mounts at startup. Models are imported and stored in the cooked
+// mesh layout, images are compressed to BC7 with their mips and everything
+// else, like SPIR-V, is stored as-is
+//
+// Usage: ashcook output.ashpak directory...
+//
+// Paths are relative to each directory's parent, so cooking build/assets
+// serves "assets/shaders/shader.vert.spv"
+
+#include <Archive.h>
+#include <Helper.h>
+#include <Ktx.h>
+#include <Log.h>
+#include <MeshFile.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+
+#include "BcEncoder.h"
+
+using namespace Ash;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::set<std::string> IMAGES = {".png", ".jpg", ".jpeg", ".tga",
+                                      ".bmp"};
+const std::set<std::string> MODELS = {".obj", ".fbx", ".gltf", ".glb", ".dae"};
+// Only needed to cook other assets, or not assets at all
+const std::set<std::string> SKIPPED = {".vert", ".frag", ".comp", ".geom",
+                                       ".tesc", ".tese", ".glsl", ".mtl",
+                                       ".ashmesh", ".txt", ".md"};
+
+struct Cooked {
+    Archive::Type type;
+    std::vector<uint8_t> data;
+};
+
+std::vector<uint8_t> readFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return data;
+}
+
+bool cook(const fs::path& path, const std::string& extension,
+          Cooked& cooked) {
+    if (IMAGES.contains(extension)) {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(path.string().c_str(), &width, &height,
+                                    &channels, STBI_rgb_alpha);
+        if (!pixels) return false;
+
+        Ktx::Image image = BcEncoder::compress(
+            VK_FORMAT_BC7_SRGB_BLOCK, pixels, static_cast<uint32_t>(width),
+            static_cast<uint32_t>(height), true);
+        stbi_image_free(pixels);
+
+        cooked = {Archive::Type::Texture, Ktx::serialize(image)};
+        return true;
+    }
+
+    if (MODELS.contains(extension)) {
+        MeshFile::Model model;
+        if (!Helper::cookModel(path.string(), model)) return false;
+
+        cooked = {Archive::Type::Mesh, MeshFile::serialize(model)};
+        return true;
+    }
+
+    Archive::Type type = extension == ".ktx2" ? Archive::Type::Texture
+                                              : Archive::Type::Raw;
+    cooked = {type, readFile(path)};
+    return true;
+}
+
+size_t align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Log::init();
+
+    if (argc < 3) {
+        APP_ERROR("Usage: ashcook output.ashpak directory...");
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Sorted so that the same assets always produce the same archive
+    std::map<std::string, Cooked> assets;
+    size_t sourceSize = 0;
+    for (int i = 2; i < argc; i++) {
+        fs::path root = fs::absolute(argv[i]).lexically_normal();
+        if (!root.has_filename()) root = root.parent_path();
+
+        if (!fs::is_directory(root)) {
+            APP_ERROR("{} is not a directory", argv[i]);
+            return 1;
+        }
+
+        for (const auto& file : fs::recursive_directory_iterator(root)) {
+            if (!file.is_regular_file()) continue;
+
+            std::string extension = file.path().extension().string();
+            std::transform(extension.begin(), extension.end(),
+                           extension.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            if (SKIPPED.contains(extension)) continue;
+
+            std::string path = Archive::normalize(
+                fs::relative(file.path(), root.parent_path()).generic_string());
+
+            Cooked cooked;
+            if (!cook(file.path(), extension, cooked)) {
+                APP_ERROR("Failed to cook {}", file.path().string());
+                return 1;
+            }
+
+            if (assets.contains(path)) APP_WARN("{} is cooked twice", path);
+            assets[path] = std::move(cooked);
+            sourceSize += file.file_size();
+        }
+    }
+
+    std::string strings;
+    std::vector<Archive::TocEntry> toc;
+    toc.reserve(assets.size());
+    for (const auto& [path, cooked] : assets) {
+        Archive::TocEntry entry{};
+        entry.type = cooked.type;
+        entry.size = cooked.data.size();
+        entry.path = static_cast<uint32_t>(strings.size());
+        strings.append(path).push_back('\0');
+        toc.push_back(entry);
+    }
+
+    Archive::Header header{};
+    header.magic = Archive::MAGIC;
+    header.version = Archive::VERSION;
+    header.entryCount = static_cast<uint32_t>(toc.size());
+    header.stringSize = static_cast<uint32_t>(strings.size());
+
+    // Data follows the index in the same order, so loading everything reads
+    // the file front to back
+    size_t tocSize = toc.size() * sizeof(Archive::TocEntry);
+    size_t offset = sizeof(Archive::Header) + tocSize + strings.size();
+    for (Archive::TocEntry& entry : toc) {
+        offset = align(offset, Archive::ALIGNMENT);
+        entry.offset = offset;
+        offset += entry.size;
+    }
+
+    std::vector<uint8_t> archive(offset);
+    std::memcpy(archive.data(), &header, sizeof(Archive::Header));
+    std::memcpy(archive.data() + sizeof(Archive::Header), toc.data(),
+                tocSize);
+    std::memcpy(archive.data() + sizeof(Archive::Header) + tocSize,
+                strings.data(), strings.size());
+
+    size_t index = 0;
+    for (const auto& [path, cooked] : assets)
+        std::memcpy(archive.data() + toc[index++].offset, cooked.data.data(),
+                    cooked.data.size());
+
+    std::ofstream file(argv[1], std::ios::binary);
+    file.write(reinterpret_cast<const char*>(archive.data()), archive.size());
+    if (!file.good()) {
+        APP_ERROR("Failed to write {}", argv[1]);
+        return 1;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    APP_INFO("Cooked {} assets into {} in {:.1f} s: {} -> {} bytes",
+             assets.size(), argv[1],
+             std::chrono::duration<double>(end - start).count(), sourceSize,
+             archive.size());
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "BcEncoder.h"
+
+#include <Helper.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace BcEncoder {
+
+namespace {
+
+using Texel = std::array<float, 4>;
+
+// Endpoints at the ends of the block's principal axis, found by power
+// iteration on the covariance of the first channels
+template <int Channels>
+void fitLine(const uint8_t* texels, Texel& start, Texel& end) {
+    Texel mean{};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < Channels; c++) mean[c] += texels[i * 4 + c];
+    for (int c = 0; c < Channels; c++) mean[c] /= 16.0f;
+
+    float covariance[Channels][Channels]{};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < Channels; a++)
+            for (int b = 0; b < Channels; b++)
+                covariance[a][b] += (texels[i * 4 + a] - mean[a]) *
+                                    (texels[i * 4 + b] - mean[b]);
+
+    Texel axis{};
+    axis.fill(1.0f);
+    for (int iteration = 0; iteration < 8; iteration++) {
+        Texel next{};
+        float length = 0.0f;
+        for (int a = 0; a < Channels; a++) {
+            for (int b = 0; b < Channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length = std::max(length, std::abs(next[a]));
+        }
+        // Every texel is the same
+        if (length == 0.0f) break;
+        for (int c = 0; c < Channels; c++) axis[c] = next[c] / length;
+    }
+
+    float norm = 0.0f;
+    for (int c = 0; c < Channels; c++) norm += axis[c] * axis[c];
+    norm = std::sqrt(norm);
+    for (int c = 0; c < Channels; c++) axis[c] /= norm;
+
+    float low = 0.0f, high = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < Channels; c++)
+            t += (texels[i * 4 + c] - mean[c]) * axis[c];
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+
+    // Pulling the ends in a little trades the extremes for the texels
+    // in between, which are the majority
+    float inset = (high - low) / 16.0f;
+    low += inset;
+    high -= inset;
+
+    for (int c = 0; c < Channels; c++) {
+        start[c] = std::clamp(mean[c] + axis[c] * high, 0.0f, 255.0f);
+        end[c] = std::clamp(mean[c] + axis[c] * low, 0.0f, 255.0f);
+    }
+}
+
+template <int Channels>
+uint32_t nearest(const uint8_t* texel, const Texel* palette, uint32_t size) {
+    uint32_t best = 0;
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t i = 0; i < size; i++) {
+        float error = 0.0f;
+        for (int c = 0; c < Channels; c++) {
+            float d = texel[c] - palette[i][c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            best = i;
+        }
+    }
+    return best;
+}
+
+uint16_t packRgb565(const Texel& color) {
+    uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+    uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+    uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+Texel unpackRgb565(uint16_t color) {
+    uint32_t r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    return {float(r << 3 | r >> 2), float(g << 2 | g >> 4),
+            float(b << 3 | b >> 2), 255.0f};
+}
+
+// A single channel block, the alpha of BC3 and both halves of BC5
+void encodeBc4(const uint8_t* texels, int channel, uint8_t* block) {
+    uint8_t high = 0, low = 255;
+    for (int i = 0; i < 16; i++) {
+        high = std::max(high, texels[i * 4 + channel]);
+        low = std::min(low, texels[i * 4 + channel]);
+    }
+
+    // With high > low there are six interpolated values between them
+    std::array<Texel, 8> palette{};
+    palette[0][0] = high;
+    palette[1][0] = low;
+    for (int i = 2; i < 8; i++)
+        palette[i][0] = ((8 - i) * high + (i - 1) * low) / 7.0f;
+
+    uint64_t indices = 0;
+    if (high > low)
+        for (int i = 0; i < 16; i++)
+            indices |= uint64_t(nearest<1>(&texels[i * 4 + channel],
+                                           palette.data(), 8))
+                       << (i * 3);
+
+    block[0] = high;
+    block[1] = low;
+    for (int i = 0; i < 6; i++) block[2 + i] = uint8_t(indices >> (i * 8));
+}
+
+struct BitWriter {
+    uint8_t* data;
+    uint32_t position = 0;
+
+    void write(uint32_t value, uint32_t bits) {
+        for (uint32_t i = 0; i < bits; i++, position++)
+            data[position / 8] |= ((value >> i) & 1) << (position % 8);
+    }
+};
+
+// Splits an endpoint into 7 bit channels and the shared low bit that
+// reproduces it best
+void quantizeBc7(const Texel& endpoint, std::array<uint32_t, 4>& channels,
+                 uint32_t& pBit) {
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t p = 0; p < 2; p++) {
+        std::array<uint32_t, 4> candidate;
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            float value = std::round((endpoint[c] - p) / 2.0f);
+            candidate[c] =
+                static_cast<uint32_t>(std::clamp(value, 0.0f, 127.0f));
+            float d = float(candidate[c] << 1 | p) - endpoint[c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            channels = candidate;
+            pBit = p;
+        }
+    }
+}
+
+}  // namespace
+
+void encodeBc1(const uint8_t* texels, uint8_t* block) {
+    Texel start, end;
+    fitLine<3>(texels, start, end);
+
+    uint16_t color0 = packRgb565(start);
+    uint16_t color1 = packRgb565(end);
+    // Four colour mode needs color0 > color1
+    if (color0 < color1) std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        std::array<Texel, 4> palette{unpackRgb565(color0),
+                                     unpackRgb565(color1)};
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        for (int i = 0; i < 16; i++)
+            indices |= nearest<3>(&texels[i * 4], palette.data(), 4) << (i * 2);
+    }
+
+    std::memcpy(block, &color0, 2);
+    std::memcpy(block + 2, &color1, 2);
+    std::memcpy(block + 4, &indices, 4);
+}
+
+void encodeBc3(const uint8_t* texels, uint8_t* block) {
+    encodeBc4(texels, 3, block);
+    encodeBc1(texels, block + 8);
+}
+
+void encodeBc5(const uint8_t* texels, uint8_t* block) {
+    encodeBc4(texels, 0, block);
+    encodeBc4(texels, 1, block + 8);
+}
+
+void encodeBc7(const uint8_t* texels, uint8_t* block) {
+    static const std::array<uint32_t, 16> weights = {
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    Texel start, end;
+    fitLine<4>(texels, start, end);
+
+    std::array<std::array<uint32_t, 4>, 2> endpoints;
+    std::array<uint32_t, 2> pBits;
+    quantizeBc7(start, endpoints[0], pBits[0]);
+    quantizeBc7(end, endpoints[1], pBits[1]);
+
+    std::array<Texel, 16> palette;
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            uint32_t e0 = endpoints[0][c] << 1 | pBits[0];
+            uint32_t e1 = endpoints[1][c] << 1 | pBits[1];
+            palette[i][c] =
+                float(((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6);
+        }
+    }
+
+    std::array<uint32_t, 16> indices;
+    for (int i = 0; i < 16; i++)
+        indices[i] = nearest<4>(&texels[i * 4], palette.data(), 16);
+
+    // The first index is stored without its top bit, which has to be 0
+    if (indices[0] & 8) {
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (uint32_t& index : indices) index = 15 - index;
+    }
+
+    std::memset(block, 0, 16);
+    BitWriter writer{block};
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.write(endpoints[0][c], 7);
+        writer.write(endpoints[1][c], 7);
+    }
+    writer.write(pBits[0], 1);
+    writer.write(pBits[1], 1);
+    writer.write(indices[0], 3);
+    for (int i = 1; i < 16; i++) writer.write(indices[i], 4);
+}
+
+std::vector<uint8_t> encode(VkFormat format, const uint8_t* pixels,
+                            uint32_t width, uint32_t height) {
+    void (*encodeBlock)(const uint8_t*, uint8_t*);
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            encodeBlock = encodeBc1;
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            encodeBlock = encodeBc3;
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            encodeBlock = encodeBc5;
+            break;
+        default:
+            encodeBlock = encodeBc7;
+            break;
+    }
+
+    uint32_t blockSize = Ash::Ktx::blockSize(format);
+    std::vector<uint8_t> result(Ash::Ktx::levelSize(format, width, height));
+    uint8_t* block = result.data();
+
+    std::array<uint8_t, 64> texels;
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t row = std::min(by + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t column = std::min(bx + x, width - 1);
+                    std::memcpy(&texels[(y * 4 + x) * 4],
+                                &pixels[(size_t(row) * width + column) * 4], 4);
+                }
+            }
+
+            encodeBlock(texels.data(), block);
+            block += blockSize;
+        }
+    }
+
+    return result;
+}
+
+Ash::Ktx::Image compress(VkFormat format, const uint8_t* pixels,
+                         uint32_t width, uint32_t height, bool srgb) {
+    Ash::Ktx::Image image;
+    image.format = format;
+    image.width = width;
+    image.height = height;
+
+    std::vector<uint8_t> level(pixels, pixels + size_t(width) * height * 4);
+    while (true) {
+        std::vector<uint8_t> blocks =
+            encode(format, level.data(), width, height);
+
+        Ash::Ktx::Level ktxLevel{};
+        ktxLevel.offset = image.data.size();
+        ktxLevel.size = blocks.size();
+        ktxLevel.width = width;
+        ktxLevel.height = height;
+        image.levels.push_back(ktxLevel);
+        image.data.insert(image.data.end(), blocks.begin(), blocks.end());
+
+        if (width == 1 && height == 1) break;
+
+        level = Ash::Helper::downsampleImage(level.data(), width, height, srgb);
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    return image;
+}
+
+}  // namespace BcEncoder
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Ktx.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// CPU encoders for the block compressed formats used by the engine. Each
+// block function takes the 16 RGBA8 texels of a 4x4 block, row by row
+namespace BcEncoder {
+
+// Opaque colour, 8 bytes
+void encodeBc1(const uint8_t* texels, uint8_t* block);
+// Colour with interpolated alpha, 16 bytes
+void encodeBc3(const uint8_t* texels, uint8_t* block);
+// Red and green as two independent channels, for normal maps, 16 bytes
+void encodeBc5(const uint8_t* texels, uint8_t* block);
+// Colour and alpha with a single subset (mode 6), 16 bytes
+void encodeBc7(const uint8_t* texels, uint8_t* block);
+
+// Encodes a whole RGBA8 image, partial blocks at the edges are padded by
+// repeating the last row and column
+std::vector<uint8_t> encode(VkFormat format, const uint8_t* pixels,
+                            uint32_t width, uint32_t height);
+
+// Encodes an image and every level of its mip chain, which is downsampled
+// in linear space unless the data isn't colour
+Ash::Ktx::Image compress(VkFormat format, const uint8_t* pixels,
+                         uint32_t width, uint32_t height, bool srgb);
+
+}  // namespace BcEncoder
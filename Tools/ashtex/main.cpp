@@ -0,0 +1,82 @@
+// Converts PNG/JPG textures into block compressed KTX2 files with a full mip
+// chain, which Renderer::loadTexture uploads without decoding
+//
+// Usage: ashtex [--bc1|--bc3|--bc5|--bc7] [--linear] input output.ktx2
+
+#include <Ktx.h>
+#include <Log.h>
+#include <stb_image.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include "BcEncoder.h"
+
+using namespace Ash;
+
+int main(int argc, char** argv) {
+    Log::init();
+
+    std::string format = "bc7";
+    bool linear = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--linear") == 0)
+            linear = true;
+        else if (std::strncmp(argv[i], "--", 2) == 0)
+            format = argv[i] + 2;
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (paths.size() != 2) {
+        APP_ERROR(
+            "Usage: ashtex [--bc1|--bc3|--bc5|--bc7] [--linear] input "
+            "output.ktx2");
+        return 1;
+    }
+
+    VkFormat vkFormat;
+    if (format == "bc1")
+        vkFormat = linear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK
+                          : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    else if (format == "bc3")
+        vkFormat =
+            linear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+    else if (format == "bc5")
+        // Normal maps, never sRGB
+        vkFormat = VK_FORMAT_BC5_UNORM_BLOCK;
+    else if (format == "bc7")
+        vkFormat =
+            linear ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+    else {
+        APP_ERROR("Unknown format {}", format);
+        return 1;
+    }
+    bool srgb = !linear && vkFormat != VK_FORMAT_BC5_UNORM_BLOCK;
+
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load(paths[0].c_str(), &width, &height, &channels,
+                                STBI_rgb_alpha);
+    if (!pixels) {
+        APP_ERROR("Failed to load {}", paths[0]);
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Ktx::Image image = BcEncoder::compress(
+        vkFormat, pixels, static_cast<uint32_t>(width),
+        static_cast<uint32_t>(height), srgb);
+    stbi_image_free(pixels);
+
+    if (!Ktx::save(paths[1], image)) return 1;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    APP_INFO("Encoded {} ({}x{}, {} levels) as {} in {:.1f} ms: {} -> {} bytes",
+             paths[0], width, height, image.levels.size(), format,
+             std::chrono::duration<double, std::milli>(end - start).count(),
+             size_t(width) * height * 4, image.data.size());
+    return 0;
+}
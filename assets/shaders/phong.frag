@@ -1,10 +1,20 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) in vec3 fragColor;
+layout (location = 0) in vec2 fragTexCoord;
+layout (location = 1) in vec3 fragNormal;
 
-layout(location = 0) out vec4 outColor;
+layout (location = 0) out vec4 outColor;
+
+layout (set = 1, binding = 0) uniform sampler2D texSampler;
+
+// A fixed directional light until lights are part of the scene
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.4, 0.3, 0.9));
+const float AMBIENT = 0.2;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec4 albedo = texture(texSampler, fragTexCoord);
+    float diffuse = max(dot(normalize(fragNormal), LIGHT_DIRECTION), 0.0);
+    outColor = vec4(albedo.rgb * (AMBIENT + (1.0 - AMBIENT) * diffuse),
+                    albedo.a);
 }
@@ -0,0 +1,68 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// For pipelines created with push constants, every instance is drawn on its
+// own with its model matrix pushed right before the draw, along with the draw
+// whose quantisation compressed positions use
+layout (push_constant) uniform DrawConstants {
+    mat4 model;
+    uint firstDraw;
+} constants;
+
+layout (set = 0, binding = 2) uniform CameraBuffer {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} camera;
+
+struct DrawData {
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+layout (std430, set = 0, binding = 4) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+// Attributes are either Vertex or CompressedVertex, which stores positions
+// relative to the mesh's bounds, the tangent's handedness in the position's w
+// and octahedral encoded normals and tangents
+layout (constant_id = 0) const bool COMPRESSED_VERTICES = false;
+
+layout (location = 0) in vec4 inPosition;
+layout (location = 1) in vec2 inTexCoord;
+layout (location = 2) in vec4 inNormal;
+layout (location = 3) in vec4 inTangent;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec4 fragTangent;
+
+// Matches encodeOctahedral in Helper.cpp
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+void main() {
+    mat4 model = constants.model;
+
+    vec3 position = inPosition.xyz;
+    vec3 normal = inNormal.xyz;
+    vec4 tangent = inTangent;
+    if (COMPRESSED_VERTICES) {
+        DrawData draw = draws[constants.firstDraw];
+        position = position * draw.positionScale.xyz + draw.positionOffset.xyz;
+
+        normal = decodeOctahedral(inNormal.xy);
+        float handedness = inPosition.w * 2.0 - 1.0;
+        tangent = vec4(decodeOctahedral(inTangent.xy), handedness);
+    }
+
+    gl_Position = camera.viewProj * model * vec4(position, 1.0);
+    fragTexCoord = inTexCoord;
+    fragNormal = mat3(model) * normal;
+    fragTangent = vec4(mat3(model) * tangent.xyz, tangent.w);
+}
@@ -1,18 +1,102 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout (set = 0, binding = 0) uniform UniformBufferObject {
+// Also compiled with NO_DRAW_PARAMETERS for devices without
+// shaderDrawParameters, which push every draw's index on its own
+#ifdef NO_DRAW_PARAMETERS
+#define DRAW_ID 0
+#else
+#extension GL_ARB_shader_draw_parameters : require
+#define DRAW_ID gl_DrawIDARB
+#endif
+
+struct ObjectData {
     mat4 model;
+};
+
+const uint STATIC_OBJECT = 0x80000000u;
+
+// Objects that may move, rewritten every frame
+layout (std430, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+// Maps each drawn instance to its object, static objects have STATIC_OBJECT
+// set and index the static buffer instead. Draws start at their group's first
+// instance. Written by the culling pass when it's enabled
+layout (std430, set = 0, binding = 1) readonly buffer InstanceBuffer {
+    uint instanceIndices[];
+};
+
+layout (set = 0, binding = 2) uniform CameraBuffer {
     mat4 view;
     mat4 proj;
-} ubo;
+    mat4 viewProj;
+} camera;
+
+// Uploaded once to device local memory
+layout (std430, set = 0, binding = 3) readonly buffer StaticObjectBuffer {
+    ObjectData staticObjects[];
+};
+
+// Turns compressed positions back into mesh space
+struct DrawData {
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+// One per draw in the render queue, only written when vertices are compressed
+layout (std430, set = 0, binding = 4) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
 
-layout (location = 0) in vec3 inPosition;
+// The draw a batch starts at, DRAW_ID counts the draws within it
+layout (push_constant) uniform DrawConstants {
+    layout (offset = 64) uint firstDraw;
+} constants;
+
+// Attributes are either Vertex or CompressedVertex, which stores positions
+// relative to the mesh's bounds, the tangent's handedness in the position's w
+// and octahedral encoded normals and tangents
+layout (constant_id = 0) const bool COMPRESSED_VERTICES = false;
+
+layout (location = 0) in vec4 inPosition;
 layout (location = 1) in vec2 inTexCoord;
+layout (location = 2) in vec4 inNormal;
+layout (location = 3) in vec4 inTangent;
 
 layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec4 fragTangent;
+
+// Matches encodeOctahedral in Helper.cpp
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    uint index = instanceIndices[gl_InstanceIndex];
+    mat4 model = (index & STATIC_OBJECT) != 0
+                     ? staticObjects[index & ~STATIC_OBJECT].model
+                     : objects[index].model;
+
+    vec3 position = inPosition.xyz;
+    vec3 normal = inNormal.xyz;
+    vec4 tangent = inTangent;
+    if (COMPRESSED_VERTICES) {
+        DrawData draw = draws[constants.firstDraw + DRAW_ID];
+        position = position * draw.positionScale.xyz + draw.positionOffset.xyz;
+
+        normal = decodeOctahedral(inNormal.xy);
+        float handedness = inPosition.w * 2.0 - 1.0;
+        tangent = vec4(decodeOctahedral(inTangent.xy), handedness);
+    }
+
+    gl_Position = camera.viewProj * model * vec4(position, 1.0);
     fragTexCoord = inTexCoord;
+    fragNormal = mat3(model) * normal;
+    fragTangent = vec4(mat3(model) * tangent.xyz, tangent.w);
 }